@@ -0,0 +1,52 @@
+#!/usr/bin/env python3
+# Stress check for 32-bit instruction addressing: writes a program of about 1.25 million
+# instructions with 250,000 labels and 125,000 strings (both past the old 65,535 limit), runs it
+# compiled, from its .rfc cache and on the switch engine, and checks the listed values each time.
+#
+#   python3 benchmarks/stress.py [path/to/b]    (defaults to src/b)
+
+import os
+import subprocess
+import sys
+import tempfile
+
+BLOCKS = 125000
+EXPECTED = [
+    "[memory at 0] Type: NUMBER Value: 374997",
+    "[memory at 1] Type: NUMBER Value: 10",
+]
+
+def write_program(path):
+    lines = ["program stress", "var acc = 0", "var i = 0"]
+    for k in range(BLOCKS):
+        lines += ["if acc >= 0 do", f"    acc = acc + {k % 7}", f'    var s = "str{k}"', "end"]
+    lines += ["while i < 10 do", "    i = i + 1", "end", "list acc", "list i", "end program"]
+    with open(path, "w") as out:
+        out.write("\n".join(lines) + "\n")
+
+def run(binary, script, label, env=None):
+    result = subprocess.run([binary, script], capture_output=True, text=True, env=env)
+    output = result.stdout.splitlines()
+    if result.returncode != 0 or output != EXPECTED:
+        print(f"{label}: FAILED (exit {result.returncode})")
+        print("\n".join(output[-10:]) + result.stderr)
+        sys.exit(1)
+    print(f"{label}: ok")
+
+def main():
+    root = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    binary = os.path.abspath(sys.argv[1] if len(sys.argv) > 1 else os.path.join(root, "src", "b"))
+
+    with tempfile.TemporaryDirectory() as work:
+        script = os.path.join(work, "stress.rf")
+        write_program(script)
+
+        run(binary, script, "compiled")
+        if not os.path.exists(os.path.join(work, "stress.rfc")):
+            print("cache: FAILED (no stress.rfc written)")
+            sys.exit(1)
+        run(binary, script, "cached")
+        run(binary, script, "switch dispatch", dict(os.environ, RF_DISPATCH="switch"))
+
+if __name__ == "__main__":
+    main()
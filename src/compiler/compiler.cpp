@@ -4,14 +4,17 @@
 
 void COMPILER::init_content() {
     // Iterate all bytecode tokens
+    // labels are stripped by link(), so their address is the index of the next real instruction
+    size_t stripped_index = 0;
+
     for (size_t i = 0; i < bytecode.size(); i++) {
         BTOKEN& token = bytecode[i];
         
         switch (token.token_type) {
             case BTOKEN_TYPE::LABEL: {
-                uint16_t label_id = token.data.number_value;
-                memory.goto_hasher->set_label_address(label_id, i);
-                break;
+                uint32_t label_id = token.data.number_value;
+                memory.goto_hasher->set_label_address(label_id, stripped_index);
+                continue;
             }
 
             // -----------------------------
@@ -40,407 +43,998 @@ void COMPILER::init_content() {
             default:
                 break;
         }
+
+        stripped_index++;
     }
 
     // Finish goto mapping
     memory.goto_hasher->fill_hashed_goto_positions();
-    memory.goto_hasher->list();
 }
 
-void COMPILER::run() {
+void COMPILER::link() {
+    // rewrite jump operands from label ids to instruction indices and drop the LABEL instructions,
+    // so a jump is a single store to ip and loops don't pay a dispatch for their label
+    size_t out = 0;
 
-    // for(int i = 0 ; i < bytecode.size();i++){
+    for (size_t i = 0; i < bytecode.size(); i++) {
+        BTOKEN token = bytecode[i];
 
-    //     if(bytecode[i].data.number_value){
-    //         std::cout<<i<<". "<<bytecode_token_type_to_string(bytecode[i].token_type)<<" "<<static_cast<double>(bytecode[i].data.number_value)<<" ";
-    //     }else{
-    //         std::cout<<i<<". "<<bytecode_token_type_to_string(bytecode[i].token_type)<<" "<<static_cast<unsigned char>(bytecode[i].data.char_value)<<" ";
-    //     }
+        switch (token.token_type) {
+            case BTOKEN_TYPE::LABEL:
+                continue;
+
+            case BTOKEN_TYPE::GOTO:
+            case BTOKEN_TYPE::GOTO_IF_FALSE:
+            case BTOKEN_TYPE::GOTO_IF_TRUE:
+            case BTOKEN_TYPE::JUMP_IF_EQ:
+            case BTOKEN_TYPE::JUMP_IF_NE:
+            case BTOKEN_TYPE::JUMP_IF_LT:
+            case BTOKEN_TYPE::JUMP_IF_GT:
+            case BTOKEN_TYPE::JUMP_IF_LE:
+            case BTOKEN_TYPE::JUMP_IF_GE:
+            case BTOKEN_TYPE::LOOP_START:
+            case BTOKEN_TYPE::LOOP_INC_BRANCH:
+            case BTOKEN_TYPE::LOOP_START_INT:
+            case BTOKEN_TYPE::LOOP_INC_BRANCH_INT:
+            case BTOKEN_TYPE::JUMP_IF_EQ_INT:
+            case BTOKEN_TYPE::JUMP_IF_NE_INT:
+            case BTOKEN_TYPE::JUMP_IF_LT_INT:
+            case BTOKEN_TYPE::JUMP_IF_GT_INT:
+            case BTOKEN_TYPE::JUMP_IF_LE_INT:
+            case BTOKEN_TYPE::JUMP_IF_GE_INT:
+            case BTOKEN_TYPE::JUMP_IF_EQ_NUM:
+            case BTOKEN_TYPE::JUMP_IF_NE_NUM:
+            case BTOKEN_TYPE::JUMP_IF_LT_NUM:
+            case BTOKEN_TYPE::JUMP_IF_GT_NUM:
+            case BTOKEN_TYPE::JUMP_IF_LE_NUM:
+            case BTOKEN_TYPE::JUMP_IF_GE_NUM: {
+                uint32_t label_id = token.data.number_value;
+                token.data.number_value = memory.goto_hasher->hashed_goto_positions[label_id];
+                break;
+            }
 
-    //     std::cout<<"\n";
-    // }
-    
-    ip=0;
-    auto start = std::chrono::high_resolution_clock::now();
+            default:
+                break;
+        }
 
-    while (ip < bytecode.size()) {
-        const BTOKEN& token = bytecode[ip];
-       // std::cout<<ip<<"\n";
-       // std::cout<<bytecode_token_type_to_string(token.token_type)<<" - "<<ip<<"\n";
+        bytecode[out++] = token;
+    }
 
-        switch (token.token_type) {
+    bytecode.erase(bytecode.begin() + out, bytecode.end());
+}
 
-            // ----------------------------------
-            // PUSH literal number onto stack
-            // ----------------------------------
-            case BTOKEN_TYPE::PUSH: {
-                registers.registers[0].value_type = VALUE_TYPE::NUMBER;
-                registers.registers[0].data.number_value = token.data.number_value;
-              //  std::cout<<registers.registers[0].data.number_value<<"p\n";
-                memory.st.push(registers.registers[0]);
-                
-                ip++;
-                break;
-            }
+// ----------------------------------
+// Stack effect of one instruction, pushes minus pops
+// ----------------------------------
+static int stack_effect(const BTOKEN& token) {
+    switch (token.token_type) {
+        case BTOKEN_TYPE::PUSH:
+        case BTOKEN_TYPE::PUSH_INT:
+        case BTOKEN_TYPE::LOAD:
+        case BTOKEN_TYPE::LOADSTRING:
+        case BTOKEN_TYPE::LOAD_LOAD_OP:
+        case BTOKEN_TYPE::LOAD_PUSH_OP:
+        case BTOKEN_TYPE::LOAD_LOAD_NUM:
+        case BTOKEN_TYPE::LOAD_PUSH_NUM:
+        case BTOKEN_TYPE::LOAD_LOAD_INT:
+        case BTOKEN_TYPE::LOAD_PUSH_INT:
+            return 1;
+
+        case BTOKEN_TYPE::LOAD_LOAD:
+        case BTOKEN_TYPE::LOAD_PUSH:
+        case BTOKEN_TYPE::LOAD_PUSH_INT_PAIR:
+            return 2;
+
+        case BTOKEN_TYPE::STORE:
+        case BTOKEN_TYPE::OP:
+        case BTOKEN_TYPE::AND:
+        case BTOKEN_TYPE::OR:
+        case BTOKEN_TYPE::GOTO_IF_FALSE:
+        case BTOKEN_TYPE::GOTO_IF_TRUE:
+        case BTOKEN_TYPE::STORE_ENUM_VALUE:
+        case BTOKEN_TYPE::ADD_NUM:
+        case BTOKEN_TYPE::SUB_NUM:
+        case BTOKEN_TYPE::MUL_NUM:
+        case BTOKEN_TYPE::DIV_NUM:
+        case BTOKEN_TYPE::EQ_NUM:
+        case BTOKEN_TYPE::NE_NUM:
+        case BTOKEN_TYPE::LT_NUM:
+        case BTOKEN_TYPE::LE_NUM:
+        case BTOKEN_TYPE::GT_NUM:
+        case BTOKEN_TYPE::GE_NUM:
+        case BTOKEN_TYPE::STORE_INT:
+        case BTOKEN_TYPE::ADD_INT:
+        case BTOKEN_TYPE::SUB_INT:
+        case BTOKEN_TYPE::MUL_INT:
+        case BTOKEN_TYPE::ARRAY_OP:
+        case BTOKEN_TYPE::DOT_PRODUCT:
+        case BTOKEN_TYPE::MATMUL:
+            return -1;
+
+        case BTOKEN_TYPE::SET_ARRAY_AT:
+        case BTOKEN_TYPE::OP_STORE:
+        case BTOKEN_TYPE::JUMP_IF_EQ:
+        case BTOKEN_TYPE::JUMP_IF_NE:
+        case BTOKEN_TYPE::JUMP_IF_LT:
+        case BTOKEN_TYPE::JUMP_IF_GT:
+        case BTOKEN_TYPE::JUMP_IF_LE:
+        case BTOKEN_TYPE::JUMP_IF_GE:
+        case BTOKEN_TYPE::JUMP_IF_EQ_NUM:
+        case BTOKEN_TYPE::JUMP_IF_NE_NUM:
+        case BTOKEN_TYPE::JUMP_IF_LT_NUM:
+        case BTOKEN_TYPE::JUMP_IF_GT_NUM:
+        case BTOKEN_TYPE::JUMP_IF_LE_NUM:
+        case BTOKEN_TYPE::JUMP_IF_GE_NUM:
+        case BTOKEN_TYPE::NUM_STORE:
+        case BTOKEN_TYPE::INT_STORE:
+        case BTOKEN_TYPE::JUMP_IF_EQ_INT:
+        case BTOKEN_TYPE::JUMP_IF_NE_INT:
+        case BTOKEN_TYPE::JUMP_IF_LT_INT:
+        case BTOKEN_TYPE::JUMP_IF_GT_INT:
+        case BTOKEN_TYPE::JUMP_IF_LE_INT:
+        case BTOKEN_TYPE::JUMP_IF_GE_INT:
+            return -2;
+
+        case BTOKEN_TYPE::LOAD_ARRAY:
+        case BTOKEN_TYPE::ALLOCATE_ARRAY:
+        case BTOKEN_TYPE::LOAD_ARRAY_AT_ND:
+            return 1 - static_cast<int>(token.slot);
+
+        case BTOKEN_TYPE::SET_ARRAY_AT_ND:
+            return -1 - static_cast<int>(token.slot);
+
+        default:
+            return 0;
+    }
+}
 
+void COMPILER::size_memory() {
+    // variable slots: the highest slot any instruction touches
+    size_t slots = 0;
+    auto use_slot = [&slots](size_t slot) { slots = std::max(slots, slot + 1); };
 
-            // ----------------------------------
-            // LIST TOP from memory stack 
-            // ----------------------------------
+    // array heap: the highest handle any instruction names, ARRAY values only ever carry those
+    size_t arrays = 0;
 
-            case BTOKEN_TYPE::LIST:{
-                this->memory.list_at(token.data.number_value);
-                ip++;
+    for (const BTOKEN& token : bytecode) {
+        switch (token.token_type) {
+            case BTOKEN_TYPE::LOAD:
+            case BTOKEN_TYPE::STORE:
+            case BTOKEN_TYPE::LIST:
+            case BTOKEN_TYPE::OP_STORE:
+            case BTOKEN_TYPE::NUM_STORE:
+            case BTOKEN_TYPE::STORE_INT:
+            case BTOKEN_TYPE::INT_STORE:
+                use_slot(static_cast<size_t>(token.data.number_value));
+                break;
+            case BTOKEN_TYPE::LOAD_LOAD_OP:
+            case BTOKEN_TYPE::LOAD_LOAD_NUM:
+            case BTOKEN_TYPE::LOAD_LOAD_INT:
+            case BTOKEN_TYPE::LOAD_LOAD:
+                use_slot(token.slot);
+                use_slot(static_cast<size_t>(token.data.number_value));
+                break;
+            case BTOKEN_TYPE::INC_LOCAL:
+            case BTOKEN_TYPE::INC_LOCAL_INT:
+            case BTOKEN_TYPE::LOAD_PUSH_OP:
+            case BTOKEN_TYPE::LOAD_PUSH_NUM:
+            case BTOKEN_TYPE::LOAD_PUSH_INT:
+            case BTOKEN_TYPE::LOAD_PUSH_INT_PAIR:
+            case BTOKEN_TYPE::LOAD_PUSH:
+                use_slot(token.slot);
+                break;
+            case BTOKEN_TYPE::LOOP_START:
+            case BTOKEN_TYPE::LOOP_INC_BRANCH:
+            case BTOKEN_TYPE::LOOP_START_INT:
+            case BTOKEN_TYPE::LOOP_INC_BRANCH_INT:
+                use_slot(token.slot);
+                use_slot(token.aux + 1); // bound and step
+                break;
+            case BTOKEN_TYPE::LOAD_ARRAY:
+            case BTOKEN_TYPE::SET_ARRAY_AT:
+            case BTOKEN_TYPE::LOAD_ARRAY_AT:
+            case BTOKEN_TYPE::ARRAY_OP:
+            case BTOKEN_TYPE::ALLOCATE_ARRAY:
+            case BTOKEN_TYPE::LOAD_ARRAY_AT_ND:
+            case BTOKEN_TYPE::SET_ARRAY_AT_ND:
+            case BTOKEN_TYPE::MATMUL:
+            case BTOKEN_TYPE::TRANSPOSE:
+                arrays = std::max(arrays, static_cast<size_t>(token.data.number_value) + 1);
+                break;
+            default:
                 break;
+        }
+    }
+
+    // operand stack: walk every path once, codegen keeps the depth at a given instruction the same on all paths
+    std::vector<bool> visited(bytecode.size(), false);
+    std::vector<std::pair<size_t, int>> pending = {{0, 0}};
+    int max_depth = 0;
+
+    while (!pending.empty()) {
+        auto [i, depth] = pending.back();
+        pending.pop_back();
+
+        for (; i < bytecode.size() && !visited[i]; i++) {
+            visited[i] = true;
+            const BTOKEN& token = bytecode[i];
+
+            depth += stack_effect(token);
+            if (depth < 0) {
+                throw_error("Bytecode pops more values than it pushes");
             }
+            max_depth = std::max(max_depth, depth);
 
-            // ----------------------------------
-            // LOAD from memory into stack
-            // ----------------------------------
-            case BTOKEN_TYPE::LOAD: {
-                uint16_t addr = token.data.number_value;
-                registers.registers[0] = memory.memory[addr]; // load into register
-                memory.st.push(registers.registers[0]);
-                ip++;
+            if (token.token_type == BTOKEN_TYPE::GOTO) {
+                pending.push_back({static_cast<size_t>(token.data.number_value), depth});
                 break;
             }
 
-            // ----------------------------------
-            // STORE from stack into memory
-            // ----------------------------------
-            case BTOKEN_TYPE::STORE: {
-                uint16_t addr = token.data.number_value;
-                registers.registers[0] = memory.st.pop_ret();
-                memory.memory[addr] = registers.registers[0];
-                ip++;
-                break;
+            switch (token.token_type) {
+                case BTOKEN_TYPE::GOTO_IF_FALSE:
+                case BTOKEN_TYPE::GOTO_IF_TRUE:
+                case BTOKEN_TYPE::JUMP_IF_EQ:
+                case BTOKEN_TYPE::JUMP_IF_NE:
+                case BTOKEN_TYPE::JUMP_IF_LT:
+                case BTOKEN_TYPE::JUMP_IF_GT:
+                case BTOKEN_TYPE::JUMP_IF_LE:
+                case BTOKEN_TYPE::JUMP_IF_GE:
+                case BTOKEN_TYPE::LOOP_START:
+                case BTOKEN_TYPE::LOOP_INC_BRANCH:
+                case BTOKEN_TYPE::LOOP_START_INT:
+                case BTOKEN_TYPE::LOOP_INC_BRANCH_INT:
+                case BTOKEN_TYPE::JUMP_IF_EQ_INT:
+                case BTOKEN_TYPE::JUMP_IF_NE_INT:
+                case BTOKEN_TYPE::JUMP_IF_LT_INT:
+                case BTOKEN_TYPE::JUMP_IF_GT_INT:
+                case BTOKEN_TYPE::JUMP_IF_LE_INT:
+                case BTOKEN_TYPE::JUMP_IF_GE_INT:
+                case BTOKEN_TYPE::JUMP_IF_EQ_NUM:
+                case BTOKEN_TYPE::JUMP_IF_NE_NUM:
+                case BTOKEN_TYPE::JUMP_IF_LT_NUM:
+                case BTOKEN_TYPE::JUMP_IF_GT_NUM:
+                case BTOKEN_TYPE::JUMP_IF_LE_NUM:
+                case BTOKEN_TYPE::JUMP_IF_GE_NUM:
+                    pending.push_back({static_cast<size_t>(token.data.number_value), depth});
+                    break;
+                default:
+                    break;
             }
+        }
+    }
 
-            // ----------------------------------
-            // ARRAY METHODS
-            // ----------------------------------
+    memory.reserve(slots, max_depth + 1, arrays); // +1, LOAD_ARRAY writes the cached top back before copying the elements
+}
 
-            case BTOKEN_TYPE::LOAD_ARRAY:{
+// ----------------------------------
+// Operator of the *_NUM fused instructions, the operands are known to be numbers
+// ----------------------------------
+static inline double numeric_op(double l, double r, unsigned char op) {
+    switch(op) {
+        case '+': return l + r;
+        case '-': return l - r;
+        case '*': return l * r;
+        case '/': return l / r;
+        case '=': return l == r;
+        case '~': return l != r;
+        case '<': return l < r;
+        case '>': return l > r;
+        case '[': return l <= r;
+        default:  return l >= r; // ']'
+    }
+}
 
-                // when you add functions make functions either be defined as void or no void and make it so that you cant store novoid function calls as  objects randomly placed 
+// integer +, - and * wrap around like the hardware does instead of being undefined on overflow
+static inline int64_t wrapping_add(int64_t l, int64_t r) { return static_cast<int64_t>(static_cast<uint64_t>(l) + static_cast<uint64_t>(r)); }
+static inline int64_t wrapping_sub(int64_t l, int64_t r) { return static_cast<int64_t>(static_cast<uint64_t>(l) - static_cast<uint64_t>(r)); }
+static inline int64_t wrapping_mul(int64_t l, int64_t r) { return static_cast<int64_t>(static_cast<uint64_t>(l) * static_cast<uint64_t>(r)); }
+
+// operator of the *_INT fused instructions, '+', '-' or '*'
+static inline int64_t integer_op(int64_t l, int64_t r, unsigned char op) {
+    switch(op) {
+        case '+': return wrapping_add(l, r);
+        case '-': return wrapping_sub(l, r);
+        default:  return wrapping_mul(l, r);
+    }
+}
 
-                uint8_t addr = token.data.number_value;
-                for(int i = memory.st.sp-1;i>=0;i--){
-                    memory.array_memory[addr][i]=memory.st.pop_ret();
-                }
+// ----------------------------------
+// Binary operator shared by OP and the fused instructions, result is left in lhs
+// ----------------------------------
+inline void COMPILER::binary_op(VALUE& lhs, const VALUE& rhs, unsigned char op) {
+
+    // fast path, plain numbers
+    if (lhs.is_number() && rhs.is_number()) {
+        const double l = lhs.number();
+        const double r = rhs.number();
+
+        switch(op) {
+            case '+': lhs.set_number(l + r); return;
+            case '-': lhs.set_number(l - r); return;
+            case '*': lhs.set_number(l * r); return;
+            case '/': lhs.set_number(l / r); return;
+            case '=': lhs.set_number(l == r); return;
+            case '~': lhs.set_number(l != r); return;
+            case '<': lhs.set_number(l < r); return;
+            case '>': lhs.set_number(l > r); return;
+            case '[': lhs.set_number(l <= r); return;
+            case ']': lhs.set_number(l >= r); return;
+        }
+    }
 
-                registers.registers[0].value_type=VALUE_TYPE::ARRAY;
-                registers.registers[0].data.array_pointer = addr;
+    // two integers stay an integer for +, - and *, division and mixed operands are done in numbers
+    if (lhs.is_integer() && rhs.is_integer()) {
+        const int64_t l = lhs.integer();
+        const int64_t r = rhs.integer();
+
+        switch(op) {
+            case '+': lhs.set_integer(wrapping_add(l, r)); return;
+            case '-': lhs.set_integer(wrapping_sub(l, r)); return;
+            case '*': lhs.set_integer(wrapping_mul(l, r)); return;
+            case '/': lhs.set_number(static_cast<double>(l) / static_cast<double>(r)); return;
+            case '=': lhs.set_number(l == r); return;
+            case '~': lhs.set_number(l != r); return;
+            case '<': lhs.set_number(l < r); return;
+            case '>': lhs.set_number(l > r); return;
+            case '[': lhs.set_number(l <= r); return;
+            case ']': lhs.set_number(l >= r); return;
+        }
+    }
 
-                memory.st.push(registers.registers[0]); // push the value               
+    if (is_numeric(lhs) && is_numeric(rhs)) {
+        lhs.set_number(numeric_op(numeric_value(lhs), numeric_value(rhs), op));
+        return;
+    }
 
-                ip++;
-                break;
-            }
+    if (lhs.type() == VALUE_TYPE::ARRAY || rhs.type() == VALUE_TYPE::ARRAY) {
+        throw_error("Operations cannot be used on arrays");
+    }
 
-            case BTOKEN_TYPE::SET_ARRAY_AT:{
-                
-                registers.registers[1]=memory.st.pop_ret(); // index 
-                registers.registers[0] = memory.st.pop_ret(); // value;
+    switch(op) {
+        // -----------------------
+        // Arithmetic (numbers only, the number/number case is handled above)
+        // -----------------------
+        case '+':
+        case '-':
+        case '*':
+        case '/':
+        {
+            throw_error("Arithmetic operators can only be used on numbers");
+            break;
+        }
 
-                if(registers.registers[1].value_type!=VALUE_TYPE::NUMBER||registers.registers[1].data.number_value>UINT8_MAX||registers.registers[1].data.number_value<0){
-                    throw_error("Array index is invalid!");
+        // -----------------------
+        // Comparison
+        // -----------------------
+        case '=': // ==
+        case '~': // !=
+        case '<':
+        case '>':
+        case '[': // <=
+        case ']': // >=
+        {
+            // Strings (only == and != make sense)
+            if(lhs.type() == VALUE_TYPE::STRING && rhs.type() == VALUE_TYPE::STRING) {
+                const auto &lhs_str = memory.string_hasher->hashed_strings[lhs.string_id()];
+                const auto &rhs_str = memory.string_hasher->hashed_strings[rhs.string_id()];
+
+                switch(op) {
+                    case '=': lhs.set_number(lhs_str == rhs_str); break;
+                    case '~': lhs.set_number(lhs_str != rhs_str); break;
+                    default:
+                        throw_error("Invalid string comparison, only '!=' and '==' allowed!");
+                        break;
                 }
-
-                memory.array_memory[(uint8_t)token.data.number_value][(uint8_t)registers.registers[1].data.number_value]=registers.registers[0];
-
-                ip++;
-                break;
             }
 
-            case BTOKEN_TYPE::LOAD_ARRAY_AT:{
+            // enums : only (!= and ==)
+            else if(lhs.type() == VALUE_TYPE::ENUM_OBJECT && rhs.type() == VALUE_TYPE::ENUM_OBJECT) {
+                // Both must be same enum type
+                if(lhs.enum_type() != rhs.enum_type()) {
+                    throw_error("Cannot compare enums of different types");
+                }
 
-                registers.registers[0]=memory.st.pop_ret(); // index
+                switch(op) {
+                    case '=': lhs.set_number(lhs.enum_value() == rhs.enum_value()); break;
+                    case '~': lhs.set_number(lhs.enum_value() != rhs.enum_value()); break;
+                    default:
+                        throw_error("Invalid enum comparison, only '==' and '!=' allowed!");
+                }
+            }
 
-                if(registers.registers[0].value_type!=VALUE_TYPE::NUMBER||registers.registers[0].data.number_value<0||registers.registers[0].data.number_value>UINT8_MAX){
-                    throw_error("Array index is invalid!");
+            // values of different types are never equal
+            else {
+                switch(op) {
+                    case '=': lhs.set_number(0); break;
+                    case '~': lhs.set_number(1); break;
+                    default:
+                        throw_error("Invalid comparison between values of different types");
                 }
+            }
 
-                registers.registers[0]=memory.array_memory[(uint8_t)token.data.number_value][(uint8_t)registers.registers[0].data.number_value];
-                memory.st.push(registers.registers[0]);
+            break;
+        }
+    }
+}
 
-                ip++;
-                break;
-            }
+// ----------------------------------
+// Slow path of the JUMP_IF_* instructions: evaluates the source comparison with OP semantics
+// and reports whether the branch for `relation` is taken
+// ----------------------------------
+bool COMPILER::branch_taken(VALUE& lhs, const VALUE& rhs, unsigned char source_op, unsigned char relation) {
+    this->binary_op(lhs, rhs, source_op);
+    const bool holds = lhs.number() != 0;
+    return source_op == relation ? holds : !holds;
+}
 
-            // ----------------------------------
-            // Enum operations
-            // ----------------------------------
-
-            case BTOKEN_TYPE::STORE_ENUM_VALUE:{
-                
-                registers.registers[0]=memory.st.pop_ret(); // we know by default the type of it
-                //std::cout<<(int)registers.registers[0].data.number_value<<"\n";
-                //std::cout<<"ip "<<ip<<"\n";
-                registers.registers[1].value_type=VALUE_TYPE::ENUM_OBJECT;
-                registers.registers[1].data.enum_data.value_id=(int)token.data.number_value;
-                registers.registers[1].data.enum_data.type_id=(int)registers.registers[0].data.number_value;
-                //std::cout<<"pos->" <<(int)registers.registers[0].data.number_value<<" val-> "<<(int)token.data.number_value<<"\n";
-                memory.enum_memory[(int)registers.registers[0].data.number_value][(int)token.data.number_value] = registers.registers[1];
-                ip++;
-                break;
-            }
+// ----------------------------------
+// Whole-array arithmetic, dest[i] = lhs[i] op rhs[i] where one side may be a scalar
+// arrays of numbers go through the SIMD kernels, anything else element by element through binary_op,
+// a dest declared with extents keeps its element type
+// ----------------------------------
+void COMPILER::array_op(uint32_t dest, const VALUE& lhs, const VALUE& rhs, unsigned char op) {
+    const bool lhs_array = lhs.type() == VALUE_TYPE::ARRAY;
+    const bool rhs_array = rhs.type() == VALUE_TYPE::ARRAY;
+    if (!lhs_array && !rhs_array) {
+        throw_error("Element-wise operations need an array operand");
+    }
 
-            case BTOKEN_TYPE::PUSH_ENUM_VALUE:{
-                registers.registers[0]=memory.st.pop_ret(); // get enum id 
-                registers.registers[1].value_type=VALUE_TYPE::ENUM_OBJECT;
-                registers.registers[1].data.enum_data.value_id=(int)token.data.number_value;
-                registers.registers[1].data.enum_data.type_id=(int)registers.registers[0].data.number_value;
-                memory.st.push(registers.registers[1]);
-                ip++;
-                break;
-            }
-        
-            // ----------------------------------
-            // Binary operator: pop 2, compute, push
-            // ----------------------------------
-            case BTOKEN_TYPE::OP: {
-                registers.registers[1] = memory.st.pop_ret(); // RHS
-                registers.registers[0] = memory.st.pop_ret(); // LHS
+    ARRAY& out = memory.array_memory[dest];
+    const bool declared = out.typed;
+    const ARRAY_LAYOUT element_layout = out.layout;
+    const ARRAY* lhs_values = lhs_array ? &memory.array_memory[lhs.array_id()] : nullptr;
+    const ARRAY* rhs_values = rhs_array ? &memory.array_memory[rhs.array_id()] : nullptr;
 
-                auto &lhs = registers.registers[0];
-                auto &rhs = registers.registers[1];
+    const size_t n = lhs_array ? lhs_values->size() : rhs_values->size();
+    if (lhs_array && rhs_array && !lhs_values->same_shape(*rhs_values)) {
+        throw_error("Arrays of different shapes can't be combined element-wise");
+    }
+    const ARRAY_SHAPE shape = lhs_array ? lhs_values->shape : rhs_values->shape; // the result has the operands' extents
+
+    const bool lhs_numbers = lhs_array ? lhs_values->layout == ARRAY_LAYOUT::NUMBERS : is_numeric(lhs);
+    const bool rhs_numbers = rhs_array ? rhs_values->layout == ARRAY_LAYOUT::NUMBERS : is_numeric(rhs);
+    if (lhs_numbers && rhs_numbers) {
+        // dest may be one of the operands, then it already holds n numbers and nothing moves
+        double* result = out.numbers_for(n);
+        const KERNEL_OPERAND l{lhs_array ? lhs_values->numbers.data() : nullptr, lhs_array ? 0 : numeric_value(lhs)};
+        const KERNEL_OPERAND r{rhs_array ? rhs_values->numbers.data() : nullptr, rhs_array ? 0 : numeric_value(rhs)};
+        if (elementwise_kernel(result, l, r, n, op)) {
+            out.shape = shape;
+            out.keep_type(declared, element_layout); // truncates into a declared integer array
+            return;
+        }
+    }
 
-                if (lhs.value_type == VALUE_TYPE::ARRAY || rhs.value_type == VALUE_TYPE::ARRAY) {
-                    throw_error("Operations cannot be used on arrays");
-                }
+    // computed aside, out may be an operand and change its layout on assign
+    std::vector<VALUE> result(n);
+    for (size_t i = 0; i < n; i++) {
+        VALUE value = lhs_array ? lhs_values->at(i) : lhs;
+        this->binary_op(value, rhs_array ? rhs_values->at(i) : rhs, op);
+        result[i] = value;
+    }
+    out.assign(result.data(), n);
+    out.shape = shape;
+    out.keep_type(declared, element_layout);
+}
 
-                switch(token.data.char_value) {
-                    // -----------------------
-                    // Arithmetic (numbers only)
-                    // -----------------------
-                    case '+':
-                    case '-':
-                    case '*':
-                    case '/':
-                    {
-                        
-                        switch(token.data.char_value) {
-                            case '+': lhs.data.number_value += rhs.data.number_value; break;
-                            case '-': lhs.data.number_value -= rhs.data.number_value; break;
-                            case '*': lhs.data.number_value *= rhs.data.number_value; break;
-                            case '/': lhs.data.number_value /= rhs.data.number_value; break;
-                        }
-                        break;
-                    }
-
-                    // -----------------------
-                    // Comparison
-                    // -----------------------
-                    case '=': // ==
-                    case '~': // !=
-                    case '<':
-                    case '>':
-                    case '[': // <=
-                    case ']': // >=
-                    {
-                        // Numbers
-                        if(lhs.value_type == VALUE_TYPE::NUMBER && rhs.value_type == VALUE_TYPE::NUMBER) {
-                            switch(token.data.char_value) {
-                                case '=': lhs.data.number_value = lhs.data.number_value == rhs.data.number_value; break;
-                                case '~': lhs.data.number_value = lhs.data.number_value != rhs.data.number_value; break;
-                                case '<': lhs.data.number_value = lhs.data.number_value < rhs.data.number_value; break;
-                                case '>': lhs.data.number_value = lhs.data.number_value > rhs.data.number_value; break;
-                                case '[': lhs.data.number_value = lhs.data.number_value <= rhs.data.number_value; break;
-                                case ']': lhs.data.number_value = lhs.data.number_value >= rhs.data.number_value; break;
-                            }
-                        }
-                        // Strings (only == and != make sense)
-                        else if(lhs.value_type == VALUE_TYPE::STRING && rhs.value_type == VALUE_TYPE::STRING) {
-                            const auto &lhs_str = memory.string_hasher->hashed_strings[lhs.data.string_pointer_to_string_hash_array];
-                            const auto &rhs_str = memory.string_hasher->hashed_strings[rhs.data.string_pointer_to_string_hash_array];
-
-                            switch(token.data.char_value) {
-                                case '=': lhs.data.number_value = lhs_str == rhs_str; break;
-                                case '~': lhs.data.number_value = lhs_str != rhs_str; break;
-                                default:
-                                    throw_error("Invalid string comparison, only '!=' and '==' allowed!");
-                                    break;
-                            }
-                        }
-
-                        // enums : only (!= and ==)
-                        else if(lhs.value_type == VALUE_TYPE::ENUM_OBJECT && rhs.value_type == VALUE_TYPE::ENUM_OBJECT) {
-                            // Both must be same enum type
-                            if(lhs.data.enum_data.type_id != rhs.data.enum_data.type_id) {
-                                throw_error("Cannot compare enums of different types");
-                            }
-
-                            switch(token.data.char_value) {
-                                case '=': lhs.data.number_value = (lhs.data.enum_data.value_id == rhs.data.enum_data.value_id); break;
-                                case '~': lhs.data.number_value = (lhs.data.enum_data.value_id != rhs.data.enum_data.value_id); break;
-                                default:
-                                    throw_error("Invalid enum comparison, only '==' and '!=' allowed!");
-                            }
-                            
-                            lhs.value_type = VALUE_TYPE::NUMBER; // result is always number
-                        }
-
-                      
-
-                        lhs.value_type = VALUE_TYPE::NUMBER; // result is always number
-                        break;
-                    }
-                }
+// integer elements reduce in int64, sums and products wrap like ADD_INT and MUL_INT, n > 0 for '<' and '>'
+static int64_t reduce_integers(const int64_t* data, size_t n, unsigned char op) {
+    switch (op) {
+        case '+': {
+            int64_t sum = 0;
+            for (size_t i = 0; i < n; i++) { sum = wrapping_add(sum, data[i]); }
+            return sum;
+        }
+        case '*': {
+            int64_t product = 1;
+            for (size_t i = 0; i < n; i++) { product = wrapping_mul(product, data[i]); }
+            return product;
+        }
+        case '<': {
+            int64_t min = data[0];
+            for (size_t i = 1; i < n; i++) { min = data[i] < min ? data[i] : min; }
+            return min;
+        }
+        case '>': {
+            int64_t max = data[0];
+            for (size_t i = 1; i < n; i++) { max = data[i] > max ? data[i] : max; }
+            return max;
+        }
+        default: {
+            int64_t count = 0;
+            for (size_t i = 0; i < n; i++) { count += data[i] != 0; }
+            return count;
+        }
+    }
+}
 
-                memory.st.push(lhs); // push result
-                ip++;
-                break;
-            }
+// ----------------------------------
+// Reduction of a whole array to one value: sum '+', product '*', minval '<', maxval '>', count '#'
+// arrays of numbers go through the SIMD kernels, integers stay integers, mixed elements are folded
+// one by one through binary_op. count is always an integer.
+// ----------------------------------
+void COMPILER::array_reduce(VALUE& value, unsigned char op) {
+    if (value.type() != VALUE_TYPE::ARRAY) {
+        throw_error("Array reductions need an array operand");
+    }
 
-            // ----------------------------------
-            // OR / AND
-            // ----------------------------------
+    const ARRAY& array = memory.array_memory[value.array_id()];
+    const size_t n = array.size();
+    if (n == 0 && (op == '<' || op == '>')) {
+        throw_error("minval and maxval need a non-empty array");
+    }
 
-            case BTOKEN_TYPE::OR: {
-                registers.registers[1] = memory.st.pop_ret(); // RHS
-                registers.registers[0] = memory.st.pop_ret(); // LHS
+    if (array.layout == ARRAY_LAYOUT::NUMBERS) {
+        double result = 0;
+        reduce_kernel(array.numbers.data(), n, op, result);
+        if (op == '#') {
+            value.set_integer(static_cast<int64_t>(result));
+        } else {
+            value.set_number(result);
+        }
+        return;
+    }
+    if (array.layout == ARRAY_LAYOUT::INTEGERS) {
+        value.set_integer(reduce_integers(array.integers.data(), n, op));
+        return;
+    }
 
-                switch (registers.registers[0].value_type){
-                    case VALUE_TYPE::STRING:
-                        throw_error("'and' operation can only be used on numbers!");
-                        break;
-                    default:
-                        break;
-                }
+    for (const VALUE& element : array.values) {
+        if (!is_numeric(element)) {
+            throw_error("Array reductions need an array of numbers");
+        }
+    }
 
-                switch (registers.registers[1].value_type){
-                    case VALUE_TYPE::STRING:
-                        throw_error("'and' operation can only be used on numbers!");
-                        break;
-                    default:
-                        break;
+    switch (op) {
+        case '+':
+        case '*':
+            // from an integer identity, a number element turns the result into a number like OP does
+            value.set_integer(op == '+' ? 0 : 1);
+            for (const VALUE& element : array.values) {
+                this->binary_op(value, element, op);
+            }
+            break;
+        case '<':
+        case '>':
+            value = array.values[0];
+            for (const VALUE& element : array.values) {
+                const double candidate = numeric_value(element);
+                if (op == '<' ? candidate < numeric_value(value) : candidate > numeric_value(value)) {
+                    value = element;
                 }
+            }
+            break;
+        default: {
+            int64_t count = 0;
+            for (const VALUE& element : array.values) {
+                count += numeric_value(element) != 0;
+            }
+            value.set_integer(count);
+            break;
+        }
+    }
+}
 
-                registers.registers[0].data.number_value =
-                    (registers.registers[0].data.number_value != 0) ||
-                    (registers.registers[1].data.number_value != 0);
+// ----------------------------------
+// var m(d1, d2, d3): the array `handle` zero-filled with those extents, each a whole number of at least 1
+// ----------------------------------
+void COMPILER::allocate_array(uint32_t handle, const VALUE* extents, uint8_t rank, bool integer) {
+    uint32_t sizes[MAX_ARRAY_RANK];
+    size_t count = 1;
+
+    for (uint8_t d = 0; d < rank; d++) {
+        const double extent = is_numeric(extents[d]) ? numeric_value(extents[d]) : 0;
+        if (extent < 1 || extent != std::floor(extent)) {
+            throw_error("Array extents must be whole numbers of at least 1");
+        }
+        if (extent > MAX_ARRAY_LEN || count * static_cast<size_t>(extent) > MAX_ARRAY_LEN) {
+            throw_error("Array is too large");
+        }
+        sizes[d] = static_cast<uint32_t>(extent);
+        count *= sizes[d];
+    }
 
-                registers.registers[0].value_type = VALUE_TYPE::NUMBER;
-                memory.st.push(registers.registers[0]);
-                ip++;
-                break;
-            }
+    memory.array_memory[handle].allocate(sizes, rank, count, integer);
+}
 
-            case BTOKEN_TYPE::AND: {
-                registers.registers[1] = memory.st.pop_ret();
-                registers.registers[0] = memory.st.pop_ret();
-                
-                switch (registers.registers[0].value_type){
-                    case VALUE_TYPE::STRING:
-                        throw_error("'and' operation can only be used on numbers!");
-                        break;
-                    default:
-                        break;
-                }
+// ----------------------------------
+// dot_product(a, b), sum of a[i] * b[i] into lhs
+// ----------------------------------
+void COMPILER::dot_product(VALUE& lhs, const VALUE& rhs) {
+    if (lhs.type() != VALUE_TYPE::ARRAY || rhs.type() != VALUE_TYPE::ARRAY) {
+        throw_error("dot_product needs two arrays");
+    }
 
-                switch (registers.registers[1].value_type){
-                    case VALUE_TYPE::STRING:
-                        throw_error("'and' operation can only be used on numbers!");
-                        break;
-                    default:
-                        break;
-                }
+    const ARRAY& a = memory.array_memory[lhs.array_id()];
+    const ARRAY& b = memory.array_memory[rhs.array_id()];
+    const size_t n = a.size();
+    if (b.size() != n) {
+        throw_error("dot_product needs arrays of the same size");
+    }
 
-                registers.registers[0].data.number_value =
-                    (registers.registers[0].data.number_value != 0) &&
-                    (registers.registers[1].data.number_value != 0);
+    if (a.layout == ARRAY_LAYOUT::NUMBERS && b.layout == ARRAY_LAYOUT::NUMBERS) {
+        lhs.set_number(dot_kernel(a.numbers.data(), b.numbers.data(), n));
+        return;
+    }
+    if (a.layout == ARRAY_LAYOUT::INTEGERS && b.layout == ARRAY_LAYOUT::INTEGERS) {
+        int64_t sum = 0;
+        for (size_t i = 0; i < n; i++) {
+            sum = wrapping_add(sum, wrapping_mul(a.integers[i], b.integers[i]));
+        }
+        lhs.set_integer(sum);
+        return;
+    }
 
-                registers.registers[0].value_type = VALUE_TYPE::NUMBER;
-                memory.st.push(registers.registers[0]);
-                ip++;
-                break;
-            }
+    VALUE sum;
+    sum.set_integer(0);
+    for (size_t i = 0; i < n; i++) {
+        VALUE product = a.at(i);
+        this->binary_op(product, b.at(i), '*'); // stops the program on anything but numbers
+        this->binary_op(sum, product, '+');
+    }
+    lhs = sum;
+}
 
-            // ----------------------------------
-            // Load STRING
-            // ----------------------------------
+// elements of a matrix operand as doubles, arrays of numbers are used in place
+static const double* matrix_numbers(const ARRAY& array, std::vector<double>& converted) {
+    if (array.layout == ARRAY_LAYOUT::NUMBERS) {
+        return array.numbers.data();
+    }
 
-            case BTOKEN_TYPE::LOADSTRING:{
-                uint16_t str_id = token.data.number_value;
+    const size_t n = array.size();
+    converted.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        const VALUE element = array.at(i);
+        if (!is_numeric(element)) {
+            throw_error("matmul needs arrays of numbers");
+        }
+        converted[i] = numeric_value(element);
+    }
+    return converted.data();
+}
 
-                registers.registers[0].value_type = VALUE_TYPE::STRING;
-                registers.registers[0].data.string_pointer_to_string_hash_array=str_id;
-                
-                memory.st.push(registers.registers[0]);
-                ip++;
-                break;
-            }
+// ----------------------------------
+// matmul(a, b) into the array `dest`: matrix times matrix, or a matrix and a vector, where a vector on
+// the left is a row and one on the right a column and the result is a vector. Numbers go through the
+// cache-blocked SIMD kernel, two integer matrices multiply in wrapping int64. A dest declared with
+// extents keeps its element type.
+// ----------------------------------
+void COMPILER::matmul(uint32_t dest, const VALUE& lhs, const VALUE& rhs) {
+    if (lhs.type() != VALUE_TYPE::ARRAY || rhs.type() != VALUE_TYPE::ARRAY) {
+        throw_error("matmul needs two arrays");
+    }
 
-            // ----------------------------------
-            // Unary NEG
-            // ----------------------------------
-            case BTOKEN_TYPE::NEG: {
-                registers.registers[0] = memory.st.pop_ret();
-                registers.registers[0].data.number_value = -registers.registers[0].data.number_value;
-                memory.st.push(registers.registers[0]);
-                ip++;
-                break;
-            }
+    const ARRAY& a = memory.array_memory[lhs.array_id()];
+    const ARRAY& b = memory.array_memory[rhs.array_id()];
+    if (a.shape.rank > 2 || b.shape.rank > 2 || (a.shape.rank == 1 && b.shape.rank == 1)) {
+        throw_error("matmul needs two matrices or a matrix and a vector");
+    }
 
-            // ----------------------------------
-            // Unary NOT
-            // ----------------------------------
-            case BTOKEN_TYPE::NOT: {
-                registers.registers[0] = memory.st.pop_ret();
-                registers.registers[0].data.number_value = !registers.registers[0].data.number_value;
-                memory.st.push(registers.registers[0]);
-                ip++;
-                break;
-            }
+    const size_t m = a.shape.rank == 2 ? a.shape.extents[0] : 1;
+    const size_t k = a.shape.rank == 2 ? a.shape.extents[1] : a.size();
+    const size_t n = b.shape.rank == 2 ? b.shape.extents[1] : 1;
+    if ((b.shape.rank == 2 ? b.shape.extents[0] : b.size()) != k) {
+        throw_error("matmul needs as many columns in the first array as rows in the second");
+    }
+    if (m * n > MAX_ARRAY_LEN) {
+        throw_error("Array is too large");
+    }
 
-            // ----------------------------------
-            // GOTO IF FALSE
-            // ----------------------------------
-
-            case BTOKEN_TYPE::GOTO_IF_FALSE:{
-                registers.registers[0]=memory.st.pop_ret();
-                
-                bool is_false = false;
-                
-                if (registers.registers[0].value_type == VALUE_TYPE::NUMBER) {
-                    is_false = (registers.registers[0].data.number_value == 0);
-                } else if (registers.registers[0].value_type == VALUE_TYPE::STRING) {
-                    is_false = (memory.string_hasher->hashed_strings[registers.registers[0].data.string_pointer_to_string_hash_array].empty());
-                } else {
-                    throw_error("Unsupported value type in GOTO_IF_FALSE");
-                }
-                
-                if(is_false == true){
-                    uint16_t label_id = token.data.number_value;
-                   // std::cout<<"going to: "<<memory.goto_hasher->hashed_goto_positions[label_id] << " from "<<ip<<'\n';
-                    ip = memory.goto_hasher->hashed_goto_positions[label_id]; // jump to label position
-                    
-                }else{
-                    ip++;
+    uint32_t extents[2] = {static_cast<uint32_t>(m), static_cast<uint32_t>(n)};
+    uint8_t rank = 2;
+    if (a.shape.rank == 1) {
+        extents[0] = n;
+        rank = 1;
+    } else if (b.shape.rank == 1) {
+        rank = 1;
+    }
+
+    const bool declared = memory.array_memory[dest].typed;
+    const ARRAY_LAYOUT element_layout = memory.array_memory[dest].layout;
+
+    // the result is built aside when dest is an operand, a = matmul(a, b) still reads the old a
+    const bool aliased = dest == lhs.array_id() || dest == rhs.array_id();
+    ARRAY scratch;
+    ARRAY& out = aliased ? scratch : memory.array_memory[dest];
+
+    if (a.layout == ARRAY_LAYOUT::INTEGERS && b.layout == ARRAY_LAYOUT::INTEGERS) {
+        out.allocate(extents, rank, m * n, true);
+        int64_t* c = out.integers.data();
+        for (size_t j = 0; j < n; j++) {
+            for (size_t p = 0; p < k; p++) {
+                const int64_t factor = b.integers[p + j * k];
+                for (size_t i = 0; i < m; i++) {
+                    c[i + j * m] = wrapping_add(c[i + j * m], wrapping_mul(a.integers[i + p * m], factor));
                 }
-                break;
             }
+        }
+    } else {
+        std::vector<double> a_converted, b_converted;
+        const double* a_numbers = matrix_numbers(a, a_converted);
+        const double* b_numbers = matrix_numbers(b, b_converted);
+        out.allocate(extents, rank, m * n, false);
+        matmul_kernel(out.numbers.data(), a_numbers, b_numbers, m, k, n);
+    }
 
-            case BTOKEN_TYPE::LABEL:{
-                ip++;
-                break;
-            }
+    if (aliased) {
+        std::swap(memory.array_memory[dest], scratch);
+    }
+    memory.array_memory[dest].keep_type(declared, element_layout);
+}
 
-            case BTOKEN_TYPE::GOTO:{
-                uint16_t label_id = token.data.number_value;
-                ip = memory.goto_hasher->hashed_goto_positions[label_id]; // jump to label position
-                break;
-            }
+// ----------------------------------
+// transpose(a) of a matrix into the array `dest`, elements of any type, a dest declared with extents
+// keeps its element type
+// ----------------------------------
+void COMPILER::transpose(uint32_t dest, const VALUE& value) {
+    if (value.type() != VALUE_TYPE::ARRAY || memory.array_memory[value.array_id()].shape.rank != 2) {
+        throw_error("transpose needs a matrix");
+    }
 
-            default:
-                throw_error("Unknown bytecode instruction");
-        }
+    const ARRAY& a = memory.array_memory[value.array_id()];
+    const size_t m = a.shape.extents[0];
+    const size_t n = a.shape.extents[1];
+    const uint32_t extents[2] = {a.shape.extents[1], a.shape.extents[0]};
+
+    const bool declared = memory.array_memory[dest].typed;
+    const ARRAY_LAYOUT element_layout = memory.array_memory[dest].layout;
+
+    const bool aliased = dest == value.array_id();
+    ARRAY scratch;
+    ARRAY& out = aliased ? scratch : memory.array_memory[dest];
+
+    if (a.layout == ARRAY_LAYOUT::NUMBERS) {
+        out.allocate(extents, 2, m * n, false);
+        transpose_kernel(out.numbers.data(), a.numbers.data(), m, n);
+    } else if (a.layout == ARRAY_LAYOUT::INTEGERS) {
+        out.allocate(extents, 2, m * n, true);
+        blocked_transpose(out.integers.data(), a.integers.data(), m, n);
+    } else {
+        std::vector<VALUE> values(m * n);
+        blocked_transpose(values.data(), a.values.data(), m, n);
+        out.assign(values.data(), values.size());
+        out.set_extents(extents, 2);
+    }
+
+    if (aliased) {
+        std::swap(memory.array_memory[dest], scratch);
+    }
+    memory.array_memory[dest].keep_type(declared, element_layout);
+}
+
+void COMPILER::run() {
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+#if RF_THREADED_DISPATCH
+    if (this->dispatch == DISPATCH_MODE::THREADED) {
+        this->run_threaded();
+    } else {
+        this->run_switch();
     }
+#else
+    this->run_switch();
+#endif
 
     auto end = std::chrono::high_resolution_clock::now();
     
-    std::chrono::duration<double, std::milli> duration_ms = end - start;
-    std::cout << "Execution time: " << duration_ms.count() << " ms\n";
+    if (this->report_time) {
+        std::chrono::duration<double, std::milli> duration_ms = end - start;
+        std::cout << "Execution time: " << duration_ms.count() << " ms\n";
+    }
     
 }
+
+// ----------------------------------
+// Offset of m[i, j, k] in a column-major array, subscripts in the order they were written
+// ----------------------------------
+__attribute__((noinline)) static void subscript_error(const ARRAY& array, const VALUE& subscript, uint8_t rank) {
+    if (array.shape.rank != rank) {
+        throw_error("Array of rank " + std::to_string(array.shape.rank) + " indexed with " + std::to_string(rank) + " subscripts");
+    }
+    throw_error(is_numeric(subscript) ? "Array index is out of bounds!" : "Array index is invalid!");
+}
+
+static inline size_t element_offset(const ARRAY& array, const VALUE* subscripts, uint8_t rank) {
+    if (array.shape.rank != rank) {
+        subscript_error(array, subscripts[0], rank);
+    }
+
+    size_t offset = 0;
+    for (uint8_t d = 0; d < rank; d++) {
+        const VALUE& subscript = subscripts[d];
+        const uint32_t extent = array.shape.extents[d];
+        uint32_t index = 0;
+
+        if (subscript.is_integer() && static_cast<uint64_t>(subscript.integer()) < extent) {
+            index = subscript.integer();
+        } else if (subscript.is_number() && subscript.number() >= 0 && subscript.number() < extent) {
+            index = subscript.number();
+        } else {
+            subscript_error(array, subscript, rank);
+        }
+        offset += static_cast<size_t>(index) * array.shape.strides[d];
+    }
+    return offset;
+}
+
+// ----------------------------------
+// Operand stack access for handlers.inc
+// the top value is cached in the engine local `tos` so most handlers never touch memory for it,
+// like the instruction pointer `ip`, which member calls from the handlers can't force back to memory,
+// the values below it sit in stack[1 .. sp). Pushing onto an empty stack spills the stale tos
+// into stack[0], which keeps SPILL / DROP free of depth checks.
+// ----------------------------------
+
+#define SPILL() (stack[sp++] = tos)        // before a new value becomes tos
+#define DROP() (tos = stack[--sp])         // pop tos
+#define DROP2() (sp -= 2, tos = stack[sp]) // pop tos and the value below it
+#define SECOND stack[sp - 1]               // value below tos
+
+// ----------------------------------
+// Switch dispatch, portable fallback
+// ----------------------------------
+
+void COMPILER::run_switch() {
+
+    VALUE tos;
+    VALUE* const stack = memory.st.stack.data();
+    int sp = 0;
+    uint32_t ip = 0;
+
+
+#define HANDLER(name) case BTOKEN_TYPE::name:
+#define NEXT() { ip++; continue; }
+#define JUMP(target) { ip = (target); continue; }
+
+    while (ip < bytecode.size()) {
+        switch (bytecode[ip].token_type) {
+
+            #include "handlers.inc"
+
+            default:
+                throw_error("Unknown bytecode instruction");
+        }
+    }
+
+    memory.st.sp = sp;
+
+#undef HANDLER
+#undef NEXT
+#undef JUMP
+}
+
+// ----------------------------------
+// Direct threaded dispatch (GCC/Clang labels as values)
+// every instruction gets its handler address resolved up front, so each handler ends in its own indirect jump
+// ----------------------------------
+
+#if RF_THREADED_DISPATCH
+void COMPILER::run_threaded() {
+
+    // indexed by BTOKEN_TYPE, keep in enum order
+    static const void* const handler_table[] = {
+        &&L_PUSH,
+        &&L_LOAD,
+        &&L_STORE,
+        &&L_OP,
+        &&L_NEG,
+        &&L_NOT,
+        &&L_LIST,
+        &&L_LOADSTRING,
+        &&L_GOTO,
+        &&L_GOTO_IF_FALSE,
+        &&L_UNKNOWN, // LABEL, stripped by link()
+        &&L_AND,
+        &&L_OR,
+        &&L_SET_ARRAY_AT,
+        &&L_LOAD_ARRAY_AT,
+        &&L_LOAD_ARRAY,
+        &&L_STORE_ENUM_VALUE,
+        &&L_PUSH_ENUM_VALUE,
+        &&L_INC_LOCAL,
+        &&L_LOAD_LOAD_OP,
+        &&L_LOAD_PUSH_OP,
+        &&L_OP_STORE,
+        &&L_LOAD_LOAD,
+        &&L_LOAD_PUSH,
+        &&L_JUMP_IF_EQ,
+        &&L_JUMP_IF_NE,
+        &&L_JUMP_IF_LT,
+        &&L_JUMP_IF_GT,
+        &&L_JUMP_IF_LE,
+        &&L_JUMP_IF_GE,
+        &&L_GOTO_IF_TRUE,
+        &&L_LOOP_START,
+        &&L_LOOP_INC_BRANCH,
+        &&L_ADD_NUM,
+        &&L_SUB_NUM,
+        &&L_MUL_NUM,
+        &&L_DIV_NUM,
+        &&L_EQ_NUM,
+        &&L_NE_NUM,
+        &&L_LT_NUM,
+        &&L_LE_NUM,
+        &&L_GT_NUM,
+        &&L_GE_NUM,
+        &&L_JUMP_IF_EQ_NUM,
+        &&L_JUMP_IF_NE_NUM,
+        &&L_JUMP_IF_LT_NUM,
+        &&L_JUMP_IF_GT_NUM,
+        &&L_JUMP_IF_LE_NUM,
+        &&L_JUMP_IF_GE_NUM,
+        &&L_LOAD_LOAD_NUM,
+        &&L_LOAD_PUSH_NUM,
+        &&L_NUM_STORE,
+        &&L_PUSH_INT,
+        &&L_STORE_INT,
+        &&L_ADD_INT,
+        &&L_SUB_INT,
+        &&L_MUL_INT,
+        &&L_JUMP_IF_EQ_INT,
+        &&L_JUMP_IF_NE_INT,
+        &&L_JUMP_IF_LT_INT,
+        &&L_JUMP_IF_GT_INT,
+        &&L_JUMP_IF_LE_INT,
+        &&L_JUMP_IF_GE_INT,
+        &&L_INC_LOCAL_INT,
+        &&L_LOOP_START_INT,
+        &&L_LOOP_INC_BRANCH_INT,
+        &&L_LOAD_LOAD_INT,
+        &&L_LOAD_PUSH_INT,
+        &&L_INT_STORE,
+        &&L_LOAD_PUSH_INT_PAIR,
+        &&L_ARRAY_COPY,
+        &&L_ARRAY_OP,
+        &&L_ARRAY_REDUCE,
+        &&L_DOT_PRODUCT,
+        &&L_ALLOCATE_ARRAY,
+        &&L_LOAD_ARRAY_AT_ND,
+        &&L_SET_ARRAY_AT_ND,
+        &&L_MATMUL,
+        &&L_TRANSPOSE,
+    };
+    static_assert(sizeof(handler_table) / sizeof(handler_table[0]) == BTOKEN_TYPE_COUNT, "handler_table is out of sync with BTOKEN_TYPE");
+
+    // one extra slot past the end so running off the program (or jumping to its end) halts
+    std::vector<const void*> threaded(bytecode.size() + 1);
+    for (size_t i = 0; i < bytecode.size(); i++) {
+        threaded[i] = handler_table[static_cast<size_t>(bytecode[i].token_type)];
+    }
+    threaded[bytecode.size()] = &&L_HALT;
+
+    const void* const* code = threaded.data();
+
+    VALUE tos;
+    VALUE* const stack = memory.st.stack.data();
+    int sp = 0;
+    uint32_t ip = 0;
+
+
+#define HANDLER(name) L_##name:
+#define NEXT() goto *code[++ip]
+#define JUMP(target) { ip = (target); goto *code[ip]; }
+
+    goto *code[ip];
+
+    {
+        #include "handlers.inc"
+    }
+
+L_UNKNOWN:
+    throw_error("Unknown bytecode instruction");
+
+L_HALT:
+    memory.st.sp = sp;
+    return;
+
+#undef HANDLER
+#undef NEXT
+#undef JUMP
+}
+#endif
+
+#undef SPILL
+#undef DROP
+#undef DROP2
+#undef SECOND
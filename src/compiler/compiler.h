@@ -4,31 +4,56 @@
 
 #include "../lexer/lexer.h"
 #include "../runtime/memory/memory.h"
+#include "peephole.h"
+#include "../runtime/memory/kernels.h"
 #include <chrono>
 
-#define MAX_REG 16
+// threaded dispatch needs labels as values (GCC/Clang), build with -DRF_NO_THREADED_DISPATCH to force the switch engine
+#if defined(__GNUC__) && !defined(RF_NO_THREADED_DISPATCH)
+#define RF_THREADED_DISPATCH 1
+#else
+#define RF_THREADED_DISPATCH 0
+#endif
 
-#pragma GCC optimize("Ofast","unroll-loops","fast-math")
-
-struct REGISTERS{
-    VALUE registers[MAX_REG]; 
+enum class DISPATCH_MODE : uint8_t {
+    SWITCH,
+    THREADED,
 };
 
+#pragma GCC optimize("Ofast","unroll-loops","fast-math")
+
 struct COMPILER{
-    REGISTERS registers;
     MEMORY memory;
     std::vector<BTOKEN>bytecode;
-    uint16_t ip=0;
+    DISPATCH_MODE dispatch = RF_THREADED_DISPATCH ? DISPATCH_MODE::THREADED : DISPATCH_MODE::SWITCH;
+    bool report_time = false; // --time
 
     public:
-        void init(const std::vector<BTOKEN>& ibytecode){
-            this->bytecode=ibytecode;
+        void init(std::vector<BTOKEN>&& ibytecode){
+            this->bytecode=std::move(ibytecode);
+            fuse_superinstructions(this->bytecode);
             this->init_content();
+            this->link();
+            this->size_memory();
             this->run();
         }
     private:
         void init_content();
+        void link();
+        void size_memory();
         void run();
+        void binary_op(VALUE& lhs, const VALUE& rhs, unsigned char op);
+        bool branch_taken(VALUE& lhs, const VALUE& rhs, unsigned char source_op, unsigned char relation);
+        void array_op(uint32_t dest, const VALUE& lhs, const VALUE& rhs, unsigned char op);
+        void array_reduce(VALUE& value, unsigned char op);
+        void dot_product(VALUE& lhs, const VALUE& rhs);
+        void allocate_array(uint32_t handle, const VALUE* extents, uint8_t rank, bool integer);
+        void matmul(uint32_t dest, const VALUE& lhs, const VALUE& rhs);
+        void transpose(uint32_t dest, const VALUE& value);
+        void run_switch();
+#if RF_THREADED_DISPATCH
+        void run_threaded();
+#endif
         
 
 };
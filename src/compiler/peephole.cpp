@@ -0,0 +1,176 @@
+#include "peephole.h"
+
+static inline bool is(const std::vector<BTOKEN>& bytecode, size_t i, BTOKEN_TYPE type){
+    return i < bytecode.size() && bytecode[i].token_type == type;
+}
+
+static inline bool is_arithmetic(unsigned char op){
+    return op == '+' || op == '-';
+}
+
+// OP operand of a type-specialized arithmetic / comparison instruction, 0 for anything else
+static inline unsigned char numeric_code(const std::vector<BTOKEN>& bytecode, size_t i){
+    if(i >= bytecode.size()){ return 0; }
+
+    switch(bytecode[i].token_type){
+        case BTOKEN_TYPE::ADD_NUM: return '+';
+        case BTOKEN_TYPE::SUB_NUM: return '-';
+        case BTOKEN_TYPE::MUL_NUM: return '*';
+        case BTOKEN_TYPE::DIV_NUM: return '/';
+        case BTOKEN_TYPE::EQ_NUM:  return '=';
+        case BTOKEN_TYPE::NE_NUM:  return '~';
+        case BTOKEN_TYPE::LT_NUM:  return '<';
+        case BTOKEN_TYPE::LE_NUM:  return '[';
+        case BTOKEN_TYPE::GT_NUM:  return '>';
+        case BTOKEN_TYPE::GE_NUM:  return ']';
+        default: return 0;
+    }
+}
+
+// OP operand of an integer arithmetic instruction, 0 for anything else
+static inline unsigned char integer_code(const std::vector<BTOKEN>& bytecode, size_t i){
+    if(i >= bytecode.size()){ return 0; }
+
+    switch(bytecode[i].token_type){
+        case BTOKEN_TYPE::ADD_INT: return '+';
+        case BTOKEN_TYPE::SUB_INT: return '-';
+        case BTOKEN_TYPE::MUL_INT: return '*';
+        default: return 0;
+    }
+}
+
+void fuse_superinstructions(std::vector<BTOKEN>& bytecode){
+    size_t out = 0;
+    size_t i = 0;
+
+    while(i < bytecode.size()){
+        const BTOKEN& token = bytecode[i];
+
+        // x = x + c / x = x - c  ->  INC_LOCAL x, +-c
+        const unsigned char step_op = is(bytecode, i + 2, BTOKEN_TYPE::OP) ? bytecode[i + 2].data.char_value : numeric_code(bytecode, i + 2);
+        if(is(bytecode, i, BTOKEN_TYPE::LOAD) && is(bytecode, i + 1, BTOKEN_TYPE::PUSH) &&
+           is(bytecode, i + 3, BTOKEN_TYPE::STORE) && is_arithmetic(step_op) &&
+           token.data.number_value == bytecode[i + 3].data.number_value){
+
+            const double step = bytecode[i + 1].data.number_value;
+            BTOKEN fused(BTOKEN_TYPE::INC_LOCAL, step_op == '+' ? step : -step);
+            fused.slot = token.data.number_value;
+
+            bytecode[out++] = fused;
+            i += 4;
+            continue;
+        }
+
+        // the same on an integer variable  ->  INC_LOCAL_INT x, +-c
+        if(is(bytecode, i, BTOKEN_TYPE::LOAD) && is(bytecode, i + 1, BTOKEN_TYPE::PUSH_INT) &&
+           (is(bytecode, i + 2, BTOKEN_TYPE::ADD_INT) || is(bytecode, i + 2, BTOKEN_TYPE::SUB_INT)) &&
+           is(bytecode, i + 3, BTOKEN_TYPE::STORE) && token.data.number_value == bytecode[i + 3].data.number_value){
+
+            const int64_t step = bytecode[i + 1].data.integer_value;
+            const int64_t negated = static_cast<int64_t>(0 - static_cast<uint64_t>(step)); // wraps like SUB_INT
+            BTOKEN fused = BTOKEN::integer(BTOKEN_TYPE::INC_LOCAL_INT, bytecode[i + 2].token_type == BTOKEN_TYPE::ADD_INT ? step : negated);
+            fused.slot = token.data.number_value;
+
+            bytecode[out++] = fused;
+            i += 4;
+            continue;
+        }
+
+        // a op b  ->  LOAD_LOAD_OP a, b, op
+        if(is(bytecode, i, BTOKEN_TYPE::LOAD) && is(bytecode, i + 1, BTOKEN_TYPE::LOAD) && is(bytecode, i + 2, BTOKEN_TYPE::OP)){
+            BTOKEN fused(BTOKEN_TYPE::LOAD_LOAD_OP, bytecode[i + 1].data.number_value);
+            fused.slot = token.data.number_value;
+            fused.op = bytecode[i + 2].data.char_value;
+
+            bytecode[out++] = fused;
+            i += 3;
+            continue;
+        }
+
+        // a op c  ->  LOAD_PUSH_OP a, c, op
+        if(is(bytecode, i, BTOKEN_TYPE::LOAD) && is(bytecode, i + 1, BTOKEN_TYPE::PUSH) && is(bytecode, i + 2, BTOKEN_TYPE::OP)){
+            BTOKEN fused(BTOKEN_TYPE::LOAD_PUSH_OP, bytecode[i + 1].data.number_value);
+            fused.slot = token.data.number_value;
+            fused.op = bytecode[i + 2].data.char_value;
+
+            bytecode[out++] = fused;
+            i += 3;
+            continue;
+        }
+
+        // x = <expr> op <expr>  ->  OP_STORE op, x
+        if(is(bytecode, i, BTOKEN_TYPE::OP) && is(bytecode, i + 1, BTOKEN_TYPE::STORE)){
+            BTOKEN fused(BTOKEN_TYPE::OP_STORE, bytecode[i + 1].data.number_value);
+            fused.op = token.data.char_value;
+
+            bytecode[out++] = fused;
+            i += 2;
+            continue;
+        }
+
+        // the same three on operands known to be numbers  ->  LOAD_LOAD_NUM / LOAD_PUSH_NUM / NUM_STORE
+        if(is(bytecode, i, BTOKEN_TYPE::LOAD) && (is(bytecode, i + 1, BTOKEN_TYPE::LOAD) || is(bytecode, i + 1, BTOKEN_TYPE::PUSH)) &&
+           numeric_code(bytecode, i + 2)){
+            const BTOKEN_TYPE type = bytecode[i + 1].token_type == BTOKEN_TYPE::LOAD ? BTOKEN_TYPE::LOAD_LOAD_NUM : BTOKEN_TYPE::LOAD_PUSH_NUM;
+            BTOKEN fused(type, bytecode[i + 1].data.number_value);
+            fused.slot = token.data.number_value;
+            fused.op = numeric_code(bytecode, i + 2);
+
+            bytecode[out++] = fused;
+            i += 3;
+            continue;
+        }
+
+        if(numeric_code(bytecode, i) && is(bytecode, i + 1, BTOKEN_TYPE::STORE)){
+            BTOKEN fused(BTOKEN_TYPE::NUM_STORE, bytecode[i + 1].data.number_value);
+            fused.op = numeric_code(bytecode, i);
+
+            bytecode[out++] = fused;
+            i += 2;
+            continue;
+        }
+
+        // and on integers  ->  LOAD_LOAD_INT / LOAD_PUSH_INT / INT_STORE
+        if(is(bytecode, i, BTOKEN_TYPE::LOAD) && (is(bytecode, i + 1, BTOKEN_TYPE::LOAD) || is(bytecode, i + 1, BTOKEN_TYPE::PUSH_INT)) &&
+           integer_code(bytecode, i + 2)){
+            const BTOKEN_TYPE type = bytecode[i + 1].token_type == BTOKEN_TYPE::LOAD ? BTOKEN_TYPE::LOAD_LOAD_INT : BTOKEN_TYPE::LOAD_PUSH_INT;
+            BTOKEN fused(type, 0.0);
+            fused.data = bytecode[i + 1].data; // second variable or the integer constant, as it is
+            fused.slot = token.data.number_value;
+            fused.op = integer_code(bytecode, i + 2);
+
+            bytecode[out++] = fused;
+            i += 3;
+            continue;
+        }
+
+        if(integer_code(bytecode, i) && is(bytecode, i + 1, BTOKEN_TYPE::STORE)){
+            BTOKEN fused(BTOKEN_TYPE::INT_STORE, bytecode[i + 1].data.number_value);
+            fused.op = integer_code(bytecode, i);
+
+            bytecode[out++] = fused;
+            i += 2;
+            continue;
+        }
+
+        // operand pairs left over, mostly in front of a compare-and-branch
+        if(is(bytecode, i, BTOKEN_TYPE::LOAD) && (is(bytecode, i + 1, BTOKEN_TYPE::LOAD) || is(bytecode, i + 1, BTOKEN_TYPE::PUSH) ||
+                                                  is(bytecode, i + 1, BTOKEN_TYPE::PUSH_INT))){
+            const BTOKEN_TYPE next = bytecode[i + 1].token_type;
+            const BTOKEN_TYPE type = next == BTOKEN_TYPE::LOAD ? BTOKEN_TYPE::LOAD_LOAD :
+                                     next == BTOKEN_TYPE::PUSH ? BTOKEN_TYPE::LOAD_PUSH : BTOKEN_TYPE::LOAD_PUSH_INT_PAIR;
+            BTOKEN fused(type, 0.0);
+            fused.data = bytecode[i + 1].data;
+            fused.slot = token.data.number_value;
+
+            bytecode[out++] = fused;
+            i += 2;
+            continue;
+        }
+
+        bytecode[out++] = token;
+        i++;
+    }
+
+    bytecode.erase(bytecode.begin() + out, bytecode.end());
+}
@@ -0,0 +1,11 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include "../lexer/lexer.h"
+#include <vector>
+
+// Replaces frequent instruction sequences with superinstructions (see the fused entries of BTOKEN_TYPE).
+// Runs before link(), while LABELs are still in the stream, so a sequence can never swallow a jump target.
+void fuse_superinstructions(std::vector<BTOKEN>& bytecode);
+
+#endif
@@ -1,42 +1,53 @@
-
 #include "lexer.h"
 #include "../error/error.h"
+#include <cstdio>
+
+// keyword lookup switches on the length first, so most identifiers are rejected after one compare
+static bool is_keyword(std::string_view word){
+    switch(word.size()){
+        case 2:
+            return word == "if" || word == "do" || word == "or";
+        case 3:
+            return word == "var" || word == "end" || word == "and";
+        case 4:
+            return word == "else" || word == "impl" || word == "list" || word == "enum";
+        case 5:
+            return word == "while";
+        case 6:
+            return word == "concat";
+        case 7:
+            return word == "program" || word == "integer";
+        default:
+            return false;
+    }
+}
 
-void LEXER::init(const std::string& source_filename, bool is_bytecode){
-    this->pos=0;
-    this->src+='\n';
-    if(!is_bytecode){
-        std::ifstream file(source_filename);
-        if(!file.is_open()){
-            throw_error("Could not open source file: " + source_filename);
-        }
+// the keywords that are binary operators
+static OPERATOR_KIND keyword_operator(std::string_view word){
+    if(word == "and") return OPERATOR_KIND::AND;
+    if(word == "or") return OPERATOR_KIND::OR;
+    if(word == "concat") return OPERATOR_KIND::CONCAT;
+    return OPERATOR_KIND::NONE;
+}
 
-        std::string line;
-        while(std::getline(file,line)){
-            this->src+=line+'\n';
-        }
+static inline bool is_digit(char c){ return c >= '0' && c <= '9'; }
+static inline bool is_alpha(char c){ return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
 
-        file.close();
-    }else{
-        this->src = source_filename;
-    }
+void LEXER::init(std::string_view source){
+    this->pos=0;
+    this->src=source;
+    this->tokens.clear();
+    this->tokens.reserve(source.size() / 2); // generous guess so big sources never regrow, untouched capacity costs no memory
 
-    if(!is_bytecode){
-        this->lex();
-        this->list(); 
-    }else{
-        this->lexb();
-        this->listb();
-    }
-    
+    this->lex();
 }
 
-const char LEXER::next() const {
+inline char LEXER::next() const {
     if(this->pos+1>=src.size()){return '\0';}
     return this->src[this->pos+1];
 }
 
-const char LEXER::peek() const {
+inline char LEXER::peek() const {
     if (this->pos >= src.size()) {return '\0';}
     return this->src[pos];
 }
@@ -45,287 +56,279 @@ inline void LEXER::advance() {
     this->pos++;
 }  
 
-inline bool LEXER::is_keyword(const std::string& val) const{
-    return std::find(keywords.begin(),keywords.end(),val)!=keywords.end();
+// token text is the source between start and the current position
+inline void LEXER::push_token(TOKEN_TYPE type, size_t start, OPERATOR_KIND op){
+    this->tokens.push_back({type, op, this->src.substr(start, this->pos - start)});
 }
 
-inline bool LEXER::is_bytecode_keyword(const std::string& val) const{
-    return std::find(bytecode_keywords.begin(),bytecode_keywords.end(),val)!=bytecode_keywords.end();
-}
-
-inline bool LEXER::expects_number(const std::string& val) const{
-    return std::find(expects_number_bytecode_keywords.begin(),expects_number_bytecode_keywords.end(),val)!=expects_number_bytecode_keywords.end();
-}
-
-// inline bool LEXER::expects_2number(const std::string& val) const {
-//     return std::find(expects_two_number_bytecode_keywords.begin(),expects_two_number_bytecode_keywords.end(),val)!=expects_two_number_bytecode_keywords.end();
-// }
-
 void LEXER::lex_num() {
-    std::string value = "";
+    // underscores are kept in the token text, the parser drops them when it builds the literal
+    size_t start = this->pos;
     bool dot_seen = false;
 
-    while (isdigit(this->peek()) || this->peek() == '_' || this->peek() == '.') {
-        char c = this->peek();
-
-        if (c == '_') {
-            // ignore underscores
-            this->advance();
-            continue;
-        }
-
-        if (c == '.') {
+    while (is_digit(this->peek()) || this->peek() == '_' || this->peek() == '.') {
+        if (this->peek() == '.') {
             if (dot_seen) {
                 throw_error("Invalid number: multiple decimal points in numeric literal");
             }
             dot_seen = true;
         }
-
-        value += c;
         this->advance();
     }
 
-    if (value.empty()) {
-        throw_error("Expected number but got empty string");
-    }
-
-    this->tokens.push_back({TOKEN_TYPE::NUMBER, value});
+    this->push_token(TOKEN_TYPE::NUMBER, start);
 }
 
 
 void LEXER::lex_identifier(){
-    std::string value = "";
-    while(isalnum(this->peek()) || this->peek() == '_'){
-        value+=this->peek();
+    size_t start = this->pos;
+    while(is_alpha(this->peek()) || is_digit(this->peek()) || this->peek() == '_'){
         this->advance();
     }
-    if(this->is_keyword(value)){
-        this->tokens.push_back({TOKEN_TYPE::KEYWORD,value});
+
+    std::string_view word = this->src.substr(start, this->pos - start);
+    if(is_keyword(word)){
+        this->tokens.push_back({TOKEN_TYPE::KEYWORD, keyword_operator(word), word});
     }else{
-        this->tokens.push_back({TOKEN_TYPE::IDENTIFIER,value});
+        this->tokens.push_back({TOKEN_TYPE::IDENTIFIER, OPERATOR_KIND::NONE, word});
     }
 }
 
 void LEXER::lex_string(){
     char quote_type = this->src[this->pos];
     this->advance(); 
-    std::string value = "";
-    while(this->peek() != quote_type){
-        if(this->peek() == '\0'){
-            throw_error("Unterminated string literal");
-        }
-        value+=this->peek();
-        this->advance();
-    }
-    this->advance();
-    this->tokens.push_back({TOKEN_TYPE::STRING,value});
-}
-
-double LEXER::find_number() {
-    std::string value;
-    bool dot_seen = false;
-
-    while (isdigit(this->peek()) || this->peek() == '.' || this->peek() == '_') {
-        char c = this->peek();
-
-        if (c == '_') {
-            // ignore underscores
-            this->advance();
-            continue;
-        }
-
-        if (c == '.') {
-            if (dot_seen) {
-                throw_error("Invalid number: multiple decimal points in a numeric literal");
-            }
-            dot_seen = true;
-        }
-
-        value += c;
-        this->advance();
-    }
 
-    if(value.empty()) {
-        throw_error("Expected number but got empty string");
+    size_t start = this->pos;
+    size_t end = this->src.find(quote_type, start);
+    if(end == std::string_view::npos){
+        throw_error("Unterminated string literal");
     }
 
-    return std::stod(value);
-}
-
-inline bool LEXER::expects_character(const std::string& val) const{
-    return std::find(expects_char_bytecode_keywords.begin(),expects_char_bytecode_keywords.end(),val)!=expects_char_bytecode_keywords.end();
-}
-
-void LEXER::lexb_identifier(){
-    std::string value = "";
-    while(isalnum(this->peek()) || this->peek() == '_'){
-        value+=this->peek();
-        this->advance();
-    }
-
-    
-    if (this->is_bytecode_keyword(value) && this->expects_number(value)) {
-        
-        this->advance();
-        double nr_found = this->find_number();
-       // if(std::floor(nr_found)!=nr_found || nr_found<0){
-        this->btokens.push_back({ string_to_bytecode_token_type(value), static_cast<double>(nr_found) });
-     //   }else if(nr_found<=UINT8_MAX && string_to_bytecode_token_type(value)!=BTOKEN_TYPE::LOADSTRING){
-     //       this->btokens.push_back({ string_to_bytecode_token_type(value), static_cast<double>(nr_found) });
-      //  }else if(nr_found<=UINT16_MAX){
-     //       this->btokens.push_back({ string_to_bytecode_token_type(value), static_cast<double>(nr_found) });
-     //   }else{
-     //       throw_error("Number too large for bytecode token: " + std::to_string(nr_found));
-    //    }
-    }else if(!this->is_bytecode_keyword(value)){
-        throw_error("Unexpected bytecode token: " + value);
-    }else if(this->expects_character(value)){ // one single character
-        this->advance();
-        unsigned char char_found = this->src[this->pos];
-        this->btokens.push_back({ string_to_bytecode_token_type(value), char_found });
-        this->advance();
-    }else{
-        this->btokens.push_back({ string_to_bytecode_token_type(value), static_cast<double>(0)  });
-        
-    }
+    this->pos = end;
+    this->push_token(TOKEN_TYPE::STRING, start);
+    this->advance();
 }
 
 void LEXER::lex(){
-    while(this->peek()!='\0'){
-        if(skippables.find(this->peek())!=std::string::npos){
-            this->advance();
-        }
-        else if(isdigit(this->peek())){
+    while(this->pos < this->src.size()){
+        const char c = this->src[this->pos];
+        const size_t start = this->pos;
+
+        if(is_digit(c)){
             this->lex_num();
+            continue;
         }
-        else if(isalpha(this->peek()) || this->peek() == '_'){
+        if(is_alpha(c) || c == '_'){
             this->lex_identifier();
+            continue;
         }
-        else{
-            switch(this->peek()){
-                case ':':
-                    if(this->pos+1<this->src.size() && this->src[this->pos+1] == ':'){
-                        this->tokens.push_back({TOKEN_TYPE::ACCESS,"::"});
-                        this->advance();
-                        this->advance();
-                    }
-                    break;
 
+        switch(c){
+            case ' ':
+            case '\n':
+            case '\t':
+            case '\r':
+                this->advance();
+                break;
+            case ':':
+                if(this->next() != ':'){
                     throw_error("Expected ':' after ':' character to form ACCESS TOKEN");
-                case '+':
-                case '-':
-                case '*':
-                case '/':
-                case '=':
-                    if(this->pos+1<this->src.size() && this->src[this->pos+1] == '='){
-                        this->advance();
-                        this->tokens.push_back({TOKEN_TYPE::OPERATOR,"=="});
-                        this->advance();
-                        break;
-                    }
-                case '<':
-                    if(this->next() == '='){
-                        this->advance();
-                        this->tokens.push_back({TOKEN_TYPE::OPERATOR,"<="});
-                        this->advance();
-                        break;
-                    }
-                case '>':
-                    if(this->next() == '='){
-                        this->advance();
-                        this->tokens.push_back({TOKEN_TYPE::OPERATOR,"<="});
-                        this->advance();
-                        break;
-                    }
-                case '!':
-
-                    if(this->pos+1<this->src.size()&&this->src[this->pos+1] == '='){
-                        this->advance();
-                        this->tokens.push_back({TOKEN_TYPE::OPERATOR,"!="});
-                        this->advance();
-                        break;
-                    }
-                    
-                    this->tokens.push_back({TOKEN_TYPE::OPERATOR,std::string(1,this->peek())});
-                    this->advance();
-                    break;
-                case '(':
-                case ')':
-                    this->tokens.push_back({TOKEN_TYPE::PAREN,std::string(1,this->peek())});
-                    this->advance();
-                    break;
-                case '{':
-                case '}':
-                    this->tokens.push_back({TOKEN_TYPE::CPAREN,std::string(1,this->peek())});
-                    this->advance();
-                    break;
-                case '[':
-                case ']':
-                    this->tokens.push_back({TOKEN_TYPE::SPAREN,std::string(1,this->peek())});
-                    this->advance();
-                    break;
-                case '"':
-                case '\'':
-                    this->lex_string();
-                    break;
-                case ',':
-                    this->tokens.push_back({TOKEN_TYPE::COMMA,","});
-                    this->advance();
-                    break;
-                default:
-                    throw_error("Unexpected character: " + std::string(1,this->peek()));
-                    break;
+                }
+                this->pos += 2;
+                this->push_token(TOKEN_TYPE::ACCESS, start);
+                break;
+            case '=':
+            case '<':
+            case '>':
+            case '!': {
+                // ==, <=, >=, != or the single character operator
+                const bool with_equals = this->next() == '=';
+                OPERATOR_KIND op;
+                switch(c){
+                    case '=': op = with_equals ? OPERATOR_KIND::EQ : OPERATOR_KIND::ASSIGN; break;
+                    case '<': op = with_equals ? OPERATOR_KIND::LE : OPERATOR_KIND::LT; break;
+                    case '>': op = with_equals ? OPERATOR_KIND::GE : OPERATOR_KIND::GT; break;
+                    default:  op = with_equals ? OPERATOR_KIND::NE : OPERATOR_KIND::NOT; break;
+                }
+                this->pos += with_equals ? 2 : 1;
+                this->push_token(TOKEN_TYPE::OPERATOR, start, op);
+                break;
             }
-        }
-    }
-}
-
-void LEXER::lexb(){
-    while(this->peek()!='\0'){
-        if(skippables.find(this->peek())!=std::string::npos){
-            this->advance();
-        }
-        else if(isalpha(this->peek())){
-            this->lexb_identifier();
-        }else{
-            throw_error("Unexpected character in bytecode: " + std::string(1,this->peek()));
+            case '+':
+                this->advance();
+                this->push_token(TOKEN_TYPE::OPERATOR, start, OPERATOR_KIND::ADD);
+                break;
+            case '-':
+                this->advance();
+                this->push_token(TOKEN_TYPE::OPERATOR, start, OPERATOR_KIND::SUB);
+                break;
+            case '*':
+                this->advance();
+                this->push_token(TOKEN_TYPE::OPERATOR, start, OPERATOR_KIND::MUL);
+                break;
+            case '/':
+                this->advance();
+                this->push_token(TOKEN_TYPE::OPERATOR, start, OPERATOR_KIND::DIV);
+                break;
+            case '(':
+            case ')':
+                this->advance();
+                this->push_token(TOKEN_TYPE::PAREN, start);
+                break;
+            case '{':
+            case '}':
+                this->advance();
+                this->push_token(TOKEN_TYPE::CPAREN, start);
+                break;
+            case '[':
+            case ']':
+                this->advance();
+                this->push_token(TOKEN_TYPE::SPAREN, start);
+                break;
+            case '"':
+            case '\'':
+                this->lex_string();
+                break;
+            case ',':
+                this->advance();
+                this->push_token(TOKEN_TYPE::COMMA, start);
+                break;
+            case '\0':
+                return; // the old line reader stopped at the first NUL as well
+            default:
+                throw_error("Unexpected character: " + std::string(1,c));
+                break;
         }
     }
 }
 
 void LEXER::list(){
-    
-    std::ios::sync_with_stdio(false);
 
     for(const auto& token : this->tokens){
         std::cout << "Type: " << token_type_to_string(token.type) << " Value: " << token.value << "\n";
     }
 }
 
-void LEXER::listb(){
-
-    std::ios::sync_with_stdio(false);
-    int I=0;
-
-    for(const auto& btoken : this->btokens){
-        std::cout << "{Type: " << this->bytecode_token_type_to_string(btoken.token_type) ;
-        if(this->expects_character(this->bytecode_token_type_to_string(btoken.token_type)) ){
-            std::cout << " Value: " << static_cast<char>(btoken.data.char_value);
-        }else if(this->expects_number(this->bytecode_token_type_to_string(btoken.token_type)) ){
-           // if(!btoken.data.char){
-                std::cout << " Value: " << (btoken.data.number_value);
-           // }else{
-          //      std::cout << " Value: " << (btoken.data.op_code);
-           // }
-        }
+std::string btoken_to_string(const BTOKEN& btoken){
+    std::string text = bytecode_token_type_to_string(btoken.token_type);
+
+    switch(btoken.token_type){
+        case BTOKEN_TYPE::INC_LOCAL:
+        case BTOKEN_TYPE::INC_LOCAL_INT:
+        case BTOKEN_TYPE::LOAD_LOAD_OP:
+        case BTOKEN_TYPE::LOAD_PUSH_OP:
+        case BTOKEN_TYPE::LOAD_LOAD:
+        case BTOKEN_TYPE::LOAD_PUSH:
+        case BTOKEN_TYPE::LOAD_LOAD_NUM:
+        case BTOKEN_TYPE::LOAD_PUSH_NUM:
+        case BTOKEN_TYPE::LOAD_LOAD_INT:
+        case BTOKEN_TYPE::LOAD_PUSH_INT:
+        case BTOKEN_TYPE::LOAD_PUSH_INT_PAIR:
+            text += ' ' + std::to_string(btoken.slot);
+            break;
+        case BTOKEN_TYPE::LOOP_START:
+        case BTOKEN_TYPE::LOOP_INC_BRANCH:
+        case BTOKEN_TYPE::LOOP_START_INT:
+        case BTOKEN_TYPE::LOOP_INC_BRANCH_INT:
+            text += ' ' + std::to_string(btoken.slot) + ' ' + std::to_string(btoken.aux);
+            break;
+        default:
+            break;
+    }
 
-        if(I+1==this->btokens.size()){       
-            std::cout << "}\n";
-        }else{
-            std::cout << "},\n";
+    switch(btoken.token_type){
+        case BTOKEN_TYPE::OP:
+            text += ' ';
+            text += static_cast<char>(btoken.data.char_value);
+            break;
+        case BTOKEN_TYPE::NEG:
+        case BTOKEN_TYPE::NOT:
+        case BTOKEN_TYPE::AND:
+        case BTOKEN_TYPE::OR:
+        case BTOKEN_TYPE::ARRAY_COPY:
+        case BTOKEN_TYPE::ADD_NUM:
+        case BTOKEN_TYPE::SUB_NUM:
+        case BTOKEN_TYPE::MUL_NUM:
+        case BTOKEN_TYPE::DIV_NUM:
+        case BTOKEN_TYPE::EQ_NUM:
+        case BTOKEN_TYPE::NE_NUM:
+        case BTOKEN_TYPE::LT_NUM:
+        case BTOKEN_TYPE::LE_NUM:
+        case BTOKEN_TYPE::GT_NUM:
+        case BTOKEN_TYPE::GE_NUM:
+        case BTOKEN_TYPE::ADD_INT:
+        case BTOKEN_TYPE::SUB_INT:
+        case BTOKEN_TYPE::MUL_INT:
+        case BTOKEN_TYPE::ARRAY_REDUCE:
+        case BTOKEN_TYPE::DOT_PRODUCT:
+            break;
+        case BTOKEN_TYPE::PUSH_INT:
+        case BTOKEN_TYPE::INC_LOCAL_INT:
+        case BTOKEN_TYPE::LOAD_PUSH_INT:
+        case BTOKEN_TYPE::LOAD_PUSH_INT_PAIR:
+            text += ' ' + std::to_string(btoken.data.integer_value);
+            break;
+        default: {
+            const double number = btoken.data.number_value;
+            char buffer[32];
+            if(std::floor(number) == number && std::fabs(number) < 1e15){
+                std::snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(number));
+            }else{
+                std::snprintf(buffer, sizeof(buffer), "%.17g", number);
+            }
+            text += ' ';
+            text += buffer;
+            break;
         }
+    }
 
-        I++;
-        
+    switch(btoken.token_type){
+        case BTOKEN_TYPE::LOAD_LOAD_OP:
+        case BTOKEN_TYPE::LOAD_PUSH_OP:
+        case BTOKEN_TYPE::OP_STORE:
+        case BTOKEN_TYPE::JUMP_IF_EQ:
+        case BTOKEN_TYPE::JUMP_IF_NE:
+        case BTOKEN_TYPE::JUMP_IF_LT:
+        case BTOKEN_TYPE::JUMP_IF_GT:
+        case BTOKEN_TYPE::JUMP_IF_LE:
+        case BTOKEN_TYPE::JUMP_IF_GE:
+        case BTOKEN_TYPE::JUMP_IF_EQ_NUM:
+        case BTOKEN_TYPE::JUMP_IF_NE_NUM:
+        case BTOKEN_TYPE::JUMP_IF_LT_NUM:
+        case BTOKEN_TYPE::JUMP_IF_GT_NUM:
+        case BTOKEN_TYPE::JUMP_IF_LE_NUM:
+        case BTOKEN_TYPE::JUMP_IF_GE_NUM:
+        case BTOKEN_TYPE::JUMP_IF_EQ_INT:
+        case BTOKEN_TYPE::JUMP_IF_NE_INT:
+        case BTOKEN_TYPE::JUMP_IF_LT_INT:
+        case BTOKEN_TYPE::JUMP_IF_GT_INT:
+        case BTOKEN_TYPE::JUMP_IF_LE_INT:
+        case BTOKEN_TYPE::JUMP_IF_GE_INT:
+        case BTOKEN_TYPE::LOAD_LOAD_NUM:
+        case BTOKEN_TYPE::LOAD_PUSH_NUM:
+        case BTOKEN_TYPE::NUM_STORE:
+        case BTOKEN_TYPE::LOAD_LOAD_INT:
+        case BTOKEN_TYPE::LOAD_PUSH_INT:
+        case BTOKEN_TYPE::INT_STORE:
+        case BTOKEN_TYPE::ARRAY_OP:
+        case BTOKEN_TYPE::ARRAY_REDUCE:
+            text += ' ';
+            text += static_cast<char>(btoken.op);
+            break;
+        case BTOKEN_TYPE::LOAD_ARRAY:
+            text += ' ' + std::to_string(btoken.slot); // element count
+            break;
+        case BTOKEN_TYPE::ALLOCATE_ARRAY:
+            text += ' ' + std::to_string(btoken.slot); // rank
+            text += btoken.aux ? " integer" : " number";
+            break;
+        case BTOKEN_TYPE::LOAD_ARRAY_AT_ND:
+        case BTOKEN_TYPE::SET_ARRAY_AT_ND:
+            text += ' ' + std::to_string(btoken.slot); // subscript count
+            break;
+        default:
+            break;
     }
+
+    return text;
 }
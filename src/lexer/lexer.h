@@ -3,6 +3,7 @@
 #define LEXER_H
 
 #include <string> 
+#include <string_view>
 #include <vector>
 #include <algorithm>
 #include <fstream>
@@ -24,6 +25,29 @@ enum TOKEN_TYPE{
     NONE
 };
 
+// operators are classified once by the lexer so the parser and codegen never compare operator text.
+// 'and', 'or' and 'concat' stay KEYWORD tokens but carry their kind as well
+enum class OPERATOR_KIND : uint8_t {
+    NONE,
+    ADD,    // +
+    SUB,    // -
+    MUL,    // *
+    DIV,    // /
+    EQ,     // ==
+    NE,     // !=
+    LT,     // <
+    LE,     // <=
+    GT,     // >
+    GE,     // >=
+    NOT,    // !
+    ASSIGN, // =
+    AND,
+    OR,
+    CONCAT,
+};
+
+constexpr size_t OPERATOR_KIND_COUNT = static_cast<size_t>(OPERATOR_KIND::CONCAT) + 1;
+
 enum class BTOKEN_TYPE: uint8_t {
     PUSH,
     LOAD,
@@ -44,8 +68,83 @@ enum class BTOKEN_TYPE: uint8_t {
     LOAD_ARRAY, // array_name, loads array
     STORE_ENUM_VALUE,  // stores enum value [id, value],id will be stack top
     PUSH_ENUM_VALUE, // pushes enum value [id,value], id will be stack top
+
+    // superinstructions, only produced by the peephole pass (compiler/peephole.cpp)
+    INC_LOCAL,    // slot += number          <- LOAD x, PUSH c, OP +/-, STORE x
+    LOAD_LOAD_OP, // push slot op var        <- LOAD a, LOAD b, OP o
+    LOAD_PUSH_OP, // push slot op number     <- LOAD a, PUSH c, OP o
+    OP_STORE,     // pop 2, op, store to var <- OP o, STORE x
+    LOAD_LOAD,    // push slot, push var     <- LOAD a, LOAD b (operands of a compare-and-branch)
+    LOAD_PUSH,    // push slot, push number  <- LOAD a, PUSH c
+
+    // compare-and-branch, pop 2 and jump when the relation holds. op keeps the source operator
+    // ('<' for JUMP_IF_GE out of `while a < b`) so non-numeric operands follow the OP rules
+    JUMP_IF_EQ,
+    JUMP_IF_NE,
+    JUMP_IF_LT,
+    JUMP_IF_GT,
+    JUMP_IF_LE,
+    JUMP_IF_GE,
+    GOTO_IF_TRUE, // `if !x do`
+
+    // counted `do i = start, end, step` loop. slot is the counter, aux the cached bound and aux + 1 the step
+    LOOP_START,      // jump past the loop when the counter already is beyond the bound
+    LOOP_INC_BRANCH, // counter += step, jump back to the body while it hasn't passed the bound
+
+    // type-specialized forms, emitted where type inference proved both operands are numbers. no tag checks
+    ADD_NUM,
+    SUB_NUM,
+    MUL_NUM,
+    DIV_NUM,
+    EQ_NUM, // comparisons push 1 or 0
+    NE_NUM,
+    LT_NUM,
+    LE_NUM,
+    GT_NUM,
+    GE_NUM,
+    JUMP_IF_EQ_NUM,
+    JUMP_IF_NE_NUM,
+    JUMP_IF_LT_NUM,
+    JUMP_IF_GT_NUM,
+    JUMP_IF_LE_NUM,
+    JUMP_IF_GE_NUM,
+    LOAD_LOAD_NUM, // LOAD_LOAD_OP, LOAD_PUSH_OP and OP_STORE fused from the forms above
+    LOAD_PUSH_NUM,
+    NUM_STORE,
+
+    // integer forms, for `integer` variables and the integer literals next to them
+    PUSH_INT,      // integer constant, operand holds its value
+    STORE_INT,     // store into an integer variable, truncates a number and rejects anything else
+    ADD_INT,       // wrap around instead of rounding, no tag checks
+    SUB_INT,
+    MUL_INT,
+    JUMP_IF_EQ_INT,
+    JUMP_IF_NE_INT,
+    JUMP_IF_LT_INT,
+    JUMP_IF_GT_INT,
+    JUMP_IF_LE_INT,
+    JUMP_IF_GE_INT,
+    INC_LOCAL_INT,       // INC_LOCAL on an integer variable
+    LOOP_START_INT,      // LOOP_START / LOOP_INC_BRANCH with an integer counter, bound and step
+    LOOP_INC_BRANCH_INT,
+    LOAD_LOAD_INT,       // LOAD_LOAD_NUM, LOAD_PUSH_NUM and NUM_STORE for ADD_INT, SUB_INT and MUL_INT
+    LOAD_PUSH_INT,
+    INT_STORE,
+    LOAD_PUSH_INT_PAIR,  // LOAD_PUSH with an integer constant, in front of a JUMP_IF_*_INT
+    ARRAY_COPY,          // replaces the array on top with a copy in a new array, for results kept past their statement
+    ARRAY_OP,            // array handle, op: whole-array arithmetic of the two top values into that array, pushes it
+    ARRAY_REDUCE,        // op: replaces the array on top with its sum '+', product '*', minval '<', maxval '>' or count '#'
+    DOT_PRODUCT,         // replaces the two arrays on top with their dot product
+    ALLOCATE_ARRAY,      // array handle, slot rank, aux 1 for integers: zero-fills the array with the extents on top, pushes it
+    LOAD_ARRAY_AT_ND,    // array handle, slot rank: replaces the subscripts on top with the element they select
+    SET_ARRAY_AT_ND,     // array handle, slot rank: stores the value below the subscripts at the element they select
+    MATMUL,              // array handle: matrix product of the two arrays on top into that array, pushes it
+    TRANSPOSE,           // array handle: transpose of the matrix on top into that array, pushes it
 };
 
+// number of BTOKEN_TYPE entries, keep in sync with the last one
+constexpr size_t BTOKEN_TYPE_COUNT = static_cast<size_t>(BTOKEN_TYPE::TRANSPOSE) + 1;
+
 /*
 
 enum logic:
@@ -54,15 +153,21 @@ for i,each enum in enums
         store enum value [i - enum id coresp, j - enum obj id coresp]
 */
 
+// value points into the source buffer handed to LEXER::init, which must outlive the tokens
 struct TOKEN{
     TOKEN_TYPE type;
-    std::string value;
+    OPERATOR_KIND op = OPERATOR_KIND::NONE; // OPERATOR tokens and the operator keywords
+    std::string_view value;
 };
 
 struct BTOKEN {
     BTOKEN_TYPE token_type;
+    unsigned char op = 0; // operator of fused instructions
+    uint16_t slot = 0;    // first variable of fused instructions
+    uint16_t aux = 0;     // second variable of loop instructions, fits in what used to be padding
     union Data {
         double number_value;
+        int64_t integer_value; // constant of PUSH_INT, INC_LOCAL_INT, LOAD_PUSH_INT and LOAD_PUSH_INT_PAIR
         unsigned char char_value;
 
         Data() {} // default constructor
@@ -74,42 +179,202 @@ struct BTOKEN {
     // Constructors for convenience
     BTOKEN(BTOKEN_TYPE t, double n) : token_type(t), data(n) {}
     BTOKEN(BTOKEN_TYPE t, unsigned char c) : token_type(t), data(c) {}
+
+    // integer constants keep all 64 bits, a double operand rounds them past 2^53
+    static BTOKEN integer(BTOKEN_TYPE t, int64_t n){
+        BTOKEN token(t, 0.0);
+        token.data.integer_value = n;
+        return token;
+    }
 };
 
+inline const char* bytecode_token_type_to_string(const BTOKEN_TYPE& type){
+    switch(type){
+        case BTOKEN_TYPE::PUSH:
+            return "PUSH";
+        case BTOKEN_TYPE::LOAD:
+            return "LOAD";
+        case BTOKEN_TYPE::STORE:
+            return "STORE";
+        case BTOKEN_TYPE::OP:
+            return "OP";
+        case BTOKEN_TYPE::NEG:
+            return "NEG";
+        case BTOKEN_TYPE::NOT:
+            return "NOT";
+        case BTOKEN_TYPE::LIST:
+            return "LIST";
+        case BTOKEN_TYPE::LOADSTRING:
+            return "LOADSTRING";
+        case BTOKEN_TYPE::STORE_ENUM_VALUE:
+            return "STORE_ENUM_VALUE";
+        case BTOKEN_TYPE::PUSH_ENUM_VALUE:
+            return "PUSH_ENUM_VALUE";
+        case BTOKEN_TYPE::GOTO:
+            return "GOTO";
+        case BTOKEN_TYPE::LOAD_ARRAY:
+            return "LOAD_ARRAY";
+        case BTOKEN_TYPE::LOAD_ARRAY_AT:
+            return "LOAD_ARRAY_AT";
+        case BTOKEN_TYPE::SET_ARRAY_AT:
+            return "SET_ARRAY_AT";
+        case BTOKEN_TYPE::GOTO_IF_FALSE:
+            return "GOTO_IF_FALSE";
+        case BTOKEN_TYPE::LABEL:
+            return "LABEL";
+        case BTOKEN_TYPE::AND:
+            return "AND";
+        case BTOKEN_TYPE::OR:
+            return "OR";
+        case BTOKEN_TYPE::INC_LOCAL:
+            return "INC_LOCAL";
+        case BTOKEN_TYPE::LOAD_LOAD_OP:
+            return "LOAD_LOAD_OP";
+        case BTOKEN_TYPE::LOAD_PUSH_OP:
+            return "LOAD_PUSH_OP";
+        case BTOKEN_TYPE::OP_STORE:
+            return "OP_STORE";
+        case BTOKEN_TYPE::LOAD_LOAD:
+            return "LOAD_LOAD";
+        case BTOKEN_TYPE::LOAD_PUSH:
+            return "LOAD_PUSH";
+        case BTOKEN_TYPE::JUMP_IF_EQ:
+            return "JUMP_IF_EQ";
+        case BTOKEN_TYPE::JUMP_IF_NE:
+            return "JUMP_IF_NE";
+        case BTOKEN_TYPE::JUMP_IF_LT:
+            return "JUMP_IF_LT";
+        case BTOKEN_TYPE::JUMP_IF_GT:
+            return "JUMP_IF_GT";
+        case BTOKEN_TYPE::JUMP_IF_LE:
+            return "JUMP_IF_LE";
+        case BTOKEN_TYPE::JUMP_IF_GE:
+            return "JUMP_IF_GE";
+        case BTOKEN_TYPE::GOTO_IF_TRUE:
+            return "GOTO_IF_TRUE";
+        case BTOKEN_TYPE::LOOP_START:
+            return "LOOP_START";
+        case BTOKEN_TYPE::LOOP_INC_BRANCH:
+            return "LOOP_INC_BRANCH";
+        case BTOKEN_TYPE::ADD_NUM:
+            return "ADD_NUM";
+        case BTOKEN_TYPE::SUB_NUM:
+            return "SUB_NUM";
+        case BTOKEN_TYPE::MUL_NUM:
+            return "MUL_NUM";
+        case BTOKEN_TYPE::DIV_NUM:
+            return "DIV_NUM";
+        case BTOKEN_TYPE::EQ_NUM:
+            return "EQ_NUM";
+        case BTOKEN_TYPE::NE_NUM:
+            return "NE_NUM";
+        case BTOKEN_TYPE::LT_NUM:
+            return "LT_NUM";
+        case BTOKEN_TYPE::LE_NUM:
+            return "LE_NUM";
+        case BTOKEN_TYPE::GT_NUM:
+            return "GT_NUM";
+        case BTOKEN_TYPE::GE_NUM:
+            return "GE_NUM";
+        case BTOKEN_TYPE::JUMP_IF_EQ_NUM:
+            return "JUMP_IF_EQ_NUM";
+        case BTOKEN_TYPE::JUMP_IF_NE_NUM:
+            return "JUMP_IF_NE_NUM";
+        case BTOKEN_TYPE::JUMP_IF_LT_NUM:
+            return "JUMP_IF_LT_NUM";
+        case BTOKEN_TYPE::JUMP_IF_GT_NUM:
+            return "JUMP_IF_GT_NUM";
+        case BTOKEN_TYPE::JUMP_IF_LE_NUM:
+            return "JUMP_IF_LE_NUM";
+        case BTOKEN_TYPE::JUMP_IF_GE_NUM:
+            return "JUMP_IF_GE_NUM";
+        case BTOKEN_TYPE::LOAD_LOAD_NUM:
+            return "LOAD_LOAD_NUM";
+        case BTOKEN_TYPE::LOAD_PUSH_NUM:
+            return "LOAD_PUSH_NUM";
+        case BTOKEN_TYPE::NUM_STORE:
+            return "NUM_STORE";
+        case BTOKEN_TYPE::PUSH_INT:
+            return "PUSH_INT";
+        case BTOKEN_TYPE::STORE_INT:
+            return "STORE_INT";
+        case BTOKEN_TYPE::ADD_INT:
+            return "ADD_INT";
+        case BTOKEN_TYPE::SUB_INT:
+            return "SUB_INT";
+        case BTOKEN_TYPE::MUL_INT:
+            return "MUL_INT";
+        case BTOKEN_TYPE::JUMP_IF_EQ_INT:
+            return "JUMP_IF_EQ_INT";
+        case BTOKEN_TYPE::JUMP_IF_NE_INT:
+            return "JUMP_IF_NE_INT";
+        case BTOKEN_TYPE::JUMP_IF_LT_INT:
+            return "JUMP_IF_LT_INT";
+        case BTOKEN_TYPE::JUMP_IF_GT_INT:
+            return "JUMP_IF_GT_INT";
+        case BTOKEN_TYPE::JUMP_IF_LE_INT:
+            return "JUMP_IF_LE_INT";
+        case BTOKEN_TYPE::JUMP_IF_GE_INT:
+            return "JUMP_IF_GE_INT";
+        case BTOKEN_TYPE::INC_LOCAL_INT:
+            return "INC_LOCAL_INT";
+        case BTOKEN_TYPE::LOOP_START_INT:
+            return "LOOP_START_INT";
+        case BTOKEN_TYPE::LOOP_INC_BRANCH_INT:
+            return "LOOP_INC_BRANCH_INT";
+        case BTOKEN_TYPE::LOAD_LOAD_INT:
+            return "LOAD_LOAD_INT";
+        case BTOKEN_TYPE::LOAD_PUSH_INT:
+            return "LOAD_PUSH_INT";
+        case BTOKEN_TYPE::INT_STORE:
+            return "INT_STORE";
+        case BTOKEN_TYPE::LOAD_PUSH_INT_PAIR:
+            return "LOAD_PUSH_INT_PAIR";
+        case BTOKEN_TYPE::ARRAY_COPY:
+            return "ARRAY_COPY";
+        case BTOKEN_TYPE::ARRAY_OP:
+            return "ARRAY_OP";
+        case BTOKEN_TYPE::ARRAY_REDUCE:
+            return "ARRAY_REDUCE";
+        case BTOKEN_TYPE::DOT_PRODUCT:
+            return "DOT_PRODUCT";
+        case BTOKEN_TYPE::ALLOCATE_ARRAY:
+            return "ALLOCATE_ARRAY";
+        case BTOKEN_TYPE::LOAD_ARRAY_AT_ND:
+            return "LOAD_ARRAY_AT_ND";
+        case BTOKEN_TYPE::SET_ARRAY_AT_ND:
+            return "SET_ARRAY_AT_ND";
+        case BTOKEN_TYPE::MATMUL:
+            return "MATMUL";
+        case BTOKEN_TYPE::TRANSPOSE:
+            return "TRANSPOSE";
+        default:
+            return "UNKNOWN";
+    }
+}
+
+// text form of a single instruction, e.g. "PUSH 5" or "OP +", used for bytecode dumps
+std::string btoken_to_string(const BTOKEN& btoken);
 
-const std::string skippables = " \n\t\r";
-const std::vector<std::string>keywords = {"if","else","while","impl","var","end","else","program","do","list","concat","and","or","enum"};
-const std::vector<std::string>bytecode_keywords = {"PUSH","LOAD","STORE","OP","NEG","NOT","LIST","LOADSTRING","GOTO","GOTO_IF_FALSE","LABEL","AND","OR","LOAD_ARRAY","SET_ARRAY_AT","LOAD_ARRAY_AT","STORE_ENUM_VALUE","PUSH_ENUM_VALUE"};
-const std::vector<std::string>expects_number_bytecode_keywords = {"PUSH","LOAD","STORE","LIST","LOADSTRING","GOTO","GOTO_IF_FALSE","LABEL","LOAD_ARRAY","SET_ARRAY_AT","LOAD_ARRAY_AT","STORE_ENUM_VALUE","PUSH_ENUM_VALUE"};
-const std::vector<std::string>expects_char_bytecode_keywords = {"OP"};
 
 struct LEXER{
-    std::string src;
+    std::string_view src; // not owned, usually a MAPPED_FILE
     
     std::vector<TOKEN>tokens;
-    std::vector<BTOKEN>btokens;
     
     public: 
-        void init(const std::string& source,bool is_bytecode=false);
+        void init(std::string_view source);
+        void list();
 
     private:
-        int pos=0;
-        const char peek() const ;
-        const char next() const;
+        size_t pos=0;
+        inline char peek() const ;
+        inline char next() const;
         inline void advance() ;
+        inline void push_token(TOKEN_TYPE type, size_t start, OPERATOR_KIND op = OPERATOR_KIND::NONE);
         void lex_num();
         void lex_identifier();
-        inline bool is_keyword(const std::string& val) const;  
-        inline bool is_bytecode_keyword(const std::string& val) const;
-        inline bool expects_number(const std::string& val) const;  
-        inline bool expects_2number(const std::string& val) const; 
-        inline bool expects_character(const std::string& val) const;
-        double find_number();
         void lex(); 
-        void lexb();
-        void list();
-        void listb();
-        void lexb_identifier();
         void lex_string();
         
         const std::string token_type_to_string(const TOKEN_TYPE& type) const{
@@ -138,92 +403,6 @@ struct LEXER{
                     return "UNKNOWN";
             }
         }
-
-        const BTOKEN_TYPE string_to_bytecode_token_type(const std::string& type){
-            if(type == "PUSH"){
-                return BTOKEN_TYPE::PUSH;
-            }else if(type == "LOAD"){
-                return BTOKEN_TYPE::LOAD;
-            }else if(type == "STORE"){
-                return BTOKEN_TYPE::STORE;
-            }else if(type == "AND"){
-                return BTOKEN_TYPE::AND;
-            }else if(type == "OR"){
-                return BTOKEN_TYPE::OR;
-            }else if(type == "LOAD_ARRAY"){
-                return BTOKEN_TYPE::LOAD_ARRAY;
-            }else if(type == "SET_ARRAY_AT"){
-                return BTOKEN_TYPE::SET_ARRAY_AT;
-            }else if(type == "OP"){
-                return BTOKEN_TYPE::OP;
-            }else if(type == "LOAD_ARRAY_AT"){
-                return BTOKEN_TYPE::LOAD_ARRAY_AT;
-            }else if(type == "NEG"){
-                return BTOKEN_TYPE::NEG;
-            }else if(type == "NOT"){
-                return BTOKEN_TYPE::NOT;
-            }else if(type == "LIST"){
-                return BTOKEN_TYPE::LIST;
-            }else if(type == "LOADSTRING"){
-                return BTOKEN_TYPE::LOADSTRING;
-            }else if(type == "GOTO"){
-                return BTOKEN_TYPE::GOTO;
-            }else if(type == "GOTO_IF_FALSE"){
-                return BTOKEN_TYPE::GOTO_IF_FALSE;
-            }else if(type == "LABEL"){
-                return BTOKEN_TYPE::LABEL;
-            }else if(type == "STORE_ENUM_VALUE"){
-                return BTOKEN_TYPE::STORE_ENUM_VALUE;
-            }else if(type == "PUSH_ENUM_VALUE"){
-                return BTOKEN_TYPE::PUSH_ENUM_VALUE;
-            }
-            else{
-                throw std::runtime_error("Unknown bytecode token type: " + type);
-            }
-        }
-
-        const std::string bytecode_token_type_to_string(const BTOKEN_TYPE& type) const{
-            switch(type){
-                case BTOKEN_TYPE::PUSH:
-                    return "PUSH";
-                case BTOKEN_TYPE::LOAD:
-                    return "LOAD";
-                case BTOKEN_TYPE::STORE:
-                    return "STORE";
-                case BTOKEN_TYPE::OP:
-                    return "OP";
-                case BTOKEN_TYPE::NEG:
-                    return "NEG";
-                case BTOKEN_TYPE::NOT:
-                    return "NOT";
-                case BTOKEN_TYPE::LIST:
-                    return "LIST";
-                case BTOKEN_TYPE::LOADSTRING:
-                    return "LOADSTRING";
-                case BTOKEN_TYPE::STORE_ENUM_VALUE:
-                    return "STORE_ENUM_VALUE";
-                case BTOKEN_TYPE::PUSH_ENUM_VALUE:
-                    return "PUSH_ENUM_VALUE";
-                case BTOKEN_TYPE::GOTO:
-                    return "GOTO";
-                case BTOKEN_TYPE::LOAD_ARRAY:
-                    return "LOAD_ARRAY";
-                case BTOKEN_TYPE::LOAD_ARRAY_AT:
-                    return "LOAD_ARRAY_AT";
-                case BTOKEN_TYPE::SET_ARRAY_AT:
-                    return "SET_ARRAY_AT";
-                case BTOKEN_TYPE::GOTO_IF_FALSE:
-                    return "GOTO_IF_FALSE";
-                case BTOKEN_TYPE::LABEL:
-                    return "LABEL";
-                case BTOKEN_TYPE::AND:
-                    return "AND";
-                case BTOKEN_TYPE::OR:
-                    return "OR";
-                default:
-                    return "UNKNOWN";
-            }
-        }
 };
 
 #endif
@@ -1,157 +1,305 @@
 
 #include "ast.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
 
-inline bool is_operator(const TOKEN& tok, const std::vector<std::string>& ops) {
-    return tok.type == TOKEN_TYPE::OPERATOR &&
-           std::find(ops.begin(), ops.end(), tok.value) != ops.end();
+inline bool is_keyword(const TOKEN& tok, std::string_view kw) {
+    return tok.type == TOKEN_TYPE::KEYWORD && tok.value == kw;
 }
 
-inline bool is_keyword(const TOKEN& tok, const std::string& kw) {
-    return tok.type == TOKEN_TYPE::KEYWORD && tok.value == kw;
+// -------------------- Operator Table --------------------
+
+struct OPERATOR_INFO {
+    uint8_t precedence;  // binding power as a binary operator, 0 when it isn't one. all are left associative
+    unsigned char code;  // OP operand / compare-and-branch op in the bytecode, 0 when it has none
+    const char* spelling;
+};
+
+static constexpr OPERATOR_INFO operator_table[OPERATOR_KIND_COUNT] = {
+    /* NONE   */ {0, 0,   "?"},
+    /* ADD    */ {4, '+', "+"},
+    /* SUB    */ {4, '-', "-"},
+    /* MUL    */ {5, '*', "*"},
+    /* DIV    */ {5, '/', "/"},
+    /* EQ     */ {3, '=', "=="},
+    /* NE     */ {3, '~', "!="},
+    /* LT     */ {3, '<', "<"},
+    /* LE     */ {3, '[', "<="},
+    /* GT     */ {3, '>', ">"},
+    /* GE     */ {3, ']', ">="},
+    /* NOT    */ {0, 0,   "!"},
+    /* ASSIGN */ {0, 0,   "="},
+    /* AND    */ {2, 0,   "and"},
+    /* OR     */ {1, 0,   "or"},
+    /* CONCAT */ {4, 0,   "concat"},
+};
+
+static inline const OPERATOR_INFO& operator_info(OPERATOR_KIND op){
+    return operator_table[static_cast<size_t>(op)];
 }
 
+// -------------------- Intrinsic Table --------------------
+
+struct INTRINSIC_INFO {
+    const char* spelling;
+    uint8_t arity;
+    BTOKEN_TYPE opcode;
+    unsigned char code;  // op of ARRAY_REDUCE, 0 for other opcodes
+    STATIC_TYPE result;  // ARRAY results are written into an array handle given to the opcode
+};
+
+static constexpr INTRINSIC_INFO intrinsic_table[] = {
+    /* SUM         */ {"sum",         1, BTOKEN_TYPE::ARRAY_REDUCE, '+', STATIC_TYPE::DYNAMIC},
+    /* PRODUCT     */ {"product",     1, BTOKEN_TYPE::ARRAY_REDUCE, '*', STATIC_TYPE::DYNAMIC},
+    /* MINVAL      */ {"minval",      1, BTOKEN_TYPE::ARRAY_REDUCE, '<', STATIC_TYPE::DYNAMIC},
+    /* MAXVAL      */ {"maxval",      1, BTOKEN_TYPE::ARRAY_REDUCE, '>', STATIC_TYPE::DYNAMIC},
+    /* COUNT       */ {"count",       1, BTOKEN_TYPE::ARRAY_REDUCE, '#', STATIC_TYPE::INTEGER},
+    /* DOT_PRODUCT */ {"dot_product", 2, BTOKEN_TYPE::DOT_PRODUCT,  0,   STATIC_TYPE::DYNAMIC},
+    /* MATMUL      */ {"matmul",      2, BTOKEN_TYPE::MATMUL,       0,   STATIC_TYPE::ARRAY},
+    /* TRANSPOSE   */ {"transpose",   1, BTOKEN_TYPE::TRANSPOSE,    0,   STATIC_TYPE::ARRAY},
+};
+
+static inline const INTRINSIC_INFO& intrinsic_info(INTRINSIC_KIND kind){
+    return intrinsic_table[static_cast<size_t>(kind)];
+}
 
-// -------------------- Expressions --------------------
-std::shared_ptr<EXPR> AST::parse_expression() {
-    return parse_or();
+static bool find_intrinsic(std::string_view name, INTRINSIC_KIND& kind){
+    for(size_t i = 0; i < std::size(intrinsic_table); i++){
+        if(name == intrinsic_table[i].spelling){
+            kind = static_cast<INTRINSIC_KIND>(i);
+            return true;
+        }
+    }
+    return false;
 }
 
-std::shared_ptr<EXPR> AST::parse_or() {
-    auto node = parse_and();
-    while(idx < tokens.size() && is_keyword(tokens[idx], "or")) {
-        auto bin = std::make_shared<EXPR>();
-        bin->type = expression_type::BINARY;
-        bin->binary_op = "or";
-        idx++;
-        bin->left = node;
-        bin->right = parse_and();
-        node = bin;
+// dimensions of var m(d1, d2, d3), MAX_ARRAY_RANK of the runtime
+static constexpr size_t MAX_RANK = 3;
+
+static inline bool is_operator(const TOKEN& tok, OPERATOR_KIND op) {
+    return tok.type == TOKEN_TYPE::OPERATOR && tok.op == op;
+}
+
+// whole numbers are read into int64 so they stay exact past 2^53, anything with a '.'
+// or too large for int64 becomes a double
+static void parse_number(std::string_view text, EXPR& literal){
+    std::string digits;
+    if(text.find('_') != std::string_view::npos){
+        // digit separators stay in the token text, drop them before the value is read
+        digits.reserve(text.size());
+        for(char c : text){
+            if(c != '_'){ digits.push_back(c); }
+        }
+        text = digits;
     }
-    return node;
+
+    const char* const last = text.data() + text.size();
+    if(text.find('.') == std::string_view::npos){
+        int64_t value = 0;
+        auto [end, ec] = std::from_chars(text.data(), last, value);
+        if(ec == std::errc() && end == last){
+            literal.whole = true;
+            literal.integer = value;
+            return;
+        }
+    }
+
+    double value = 0;
+    auto [end, ec] = std::from_chars(text.data(), last, value);
+    if(ec != std::errc() || end != last){
+        throw_error("Invalid number literal: " + std::string(text));
+    }
+    literal.whole = false;
+    literal.number = value;
 }
 
-std::shared_ptr<EXPR> AST::parse_and() {
-    auto node = parse_comparision();
-    while(idx < tokens.size() && is_keyword(tokens[idx], "and")) {
-        auto bin = std::make_shared<EXPR>();
-        bin->type = expression_type::BINARY;
-        bin->binary_op = "and";
-        idx++;
-        bin->left = node;
-        bin->right = parse_comparision();
-        node = bin;
+// value of a NUMBER literal the way PUSH sees it
+static inline double literal_number(const EXPR& expr){
+    return expr.whole ? static_cast<double>(expr.integer) : expr.number;
+}
+
+// -------------------- Arena Helpers --------------------
+
+EXPR_ID AST::new_expr(expression_type type){
+    if(this->exprs.size() >= NO_NODE){
+        throw_error("Program too large, expression limit reached");
     }
-    return node;
+    EXPR_ID id = static_cast<EXPR_ID>(this->exprs.size());
+    this->exprs.emplace_back();
+    this->exprs.back().type = type;
+    return id;
 }
 
-std::shared_ptr<EXPR> AST::parse_comparision() {
-    auto node = parse_additive();
-    while(idx < tokens.size() && is_operator(tokens[idx], {"==", "!=", "<", "<=", ">", ">="})) {
-        auto op = tokens[idx].value;
-        idx++;
-        auto right = parse_additive();
-        auto bin = std::make_shared<EXPR>();
-        bin->type = expression_type::BINARY;
-        bin->binary_op = op;
-        bin->left = node;
-        bin->right = right;
-        node = bin;
+STMT_ID AST::new_stmt(stmt_type type){
+    if(this->stmts.size() >= NO_NODE){
+        throw_error("Program too large, statement limit reached");
     }
-    return node;
+    STMT_ID id = static_cast<STMT_ID>(this->stmts.size());
+    this->stmts.emplace_back();
+    this->stmts.back().type = type;
+    return id;
 }
 
-std::shared_ptr<EXPR> AST::parse_additive() {
-    auto node = parse_term();
-    while(idx < tokens.size() &&
-          (is_operator(tokens[idx], {"+", "-"}) || (tokens[idx].type == TOKEN_TYPE::KEYWORD && tokens[idx].value == "concat"))) {
+// children are collected on the side while their own subtrees are parsed, then stored as one run
+NODE_RANGE AST::push_list(std::vector<uint32_t>& list, const std::vector<uint32_t>& items){
+    NODE_RANGE range{static_cast<uint32_t>(list.size()), static_cast<uint32_t>(items.size())};
+    list.insert(list.end(), items.begin(), items.end());
+    return range;
+}
 
-        auto op = tokens[idx].value;
-        idx++;
-        auto right = parse_term();
+bool AST::is_declared(NAME_ID name) const {
+    return name != NO_NAME && this->var_codification[name] != NO_SLOT;
+}
 
-        if(op == "concat") {
-            if(node->type != expression_type::LITERAL || right->type != expression_type::LITERAL ||
-               node->literal_type != TOKEN_TYPE::STRING || right->literal_type != TOKEN_TYPE::STRING)
-                throw_error("'concat' operator requires string literals only");
-        }
+EXPR_ID AST::make_binary(OPERATOR_KIND op, EXPR_ID left, EXPR_ID right){
+    EXPR_ID id = new_expr(expression_type::BINARY);
+    EXPR& bin = this->exprs[id];
+    bin.op = op;
+    bin.binary.left = left;
+    bin.binary.right = right;
+    return id;
+}
 
-        auto bin = std::make_shared<EXPR>();
-        bin->type = expression_type::BINARY;
-        bin->binary_op = op;
-        bin->left = node;
-        bin->right = right;
-        node = bin;
-    }
-    return node;
+// -------------------- Expressions --------------------
+EXPR_ID AST::parse_expression() {
+    return parse_binary(1);
 }
 
-std::shared_ptr<EXPR> AST::parse_term() {
-    auto node = parse_unary();
-    while(idx < tokens.size() && is_operator(tokens[idx], {"*", "/"})) {
-        auto op = tokens[idx].value;
+// precedence climbing over operator_table: or < and < comparisons < + - concat < * /
+EXPR_ID AST::parse_binary(int min_precedence) {
+    EXPR_ID node = parse_unary();
+
+    while(idx < tokens.size()) {
+        const OPERATOR_KIND op = tokens[idx].op;
+        const int precedence = operator_info(op).precedence;
+        if(precedence == 0 || precedence < min_precedence) {
+            break;
+        }
+
         idx++;
-        auto right = parse_unary();
-        auto bin = std::make_shared<EXPR>();
-        bin->type = expression_type::BINARY;
-        bin->binary_op = op;
-        bin->left = node;
-        bin->right = right;
-        node = bin;
+        EXPR_ID right = parse_binary(precedence + 1);
+
+        if(op == OPERATOR_KIND::CONCAT) {
+            const EXPR& l = exprs[node];
+            const EXPR& r = exprs[right];
+            if(l.type != expression_type::LITERAL || r.type != expression_type::LITERAL ||
+               l.literal_type != TOKEN_TYPE::STRING || r.literal_type != TOKEN_TYPE::STRING)
+                throw_error("'concat' operator requires string literals only");
+        }
+
+        node = make_binary(op, node, right);
     }
     return node;
 }
 
-std::shared_ptr<EXPR> AST::parse_array_access(std::shared_ptr<EXPR> node) {
+EXPR_ID AST::parse_array_access(EXPR_ID node) {
     while(idx < tokens.size() && tokens[idx].type == TOKEN_TYPE::SPAREN && tokens[idx].value == "[") {
         idx++; // skip '['
-        auto index_expr = parse_expression();
+        EXPR_ID index_expr = parse_expression();
+
+        if(idx < tokens.size() && tokens[idx].type == TOKEN_TYPE::COMMA){
+            // m[i, j, k], one subscript per dimension
+            std::vector<EXPR_ID> subscripts = {index_expr};
+            while(idx < tokens.size() && tokens[idx].type == TOKEN_TYPE::COMMA){
+                idx++;
+                subscripts.push_back(parse_expression());
+            }
+            if(idx >= tokens.size() || tokens[idx].value != "]")
+                throw_error("Expected ']' after array subscripts");
+            idx++;
+            if(subscripts.size() > MAX_RANK)
+                throw_error("Arrays have at most " + std::to_string(MAX_RANK) + " dimensions");
+
+            const NAME_ID array_name = exprs[node].name;
+            EXPR_ID access_node = new_expr(expression_type::ARRAY_ACCESS_ND);
+            exprs[access_node].access_nd.array = array_name;
+            exprs[access_node].access_nd.subscripts = push_list(expr_lists, subscripts);
+            return access_node;
+        }
+
         if(idx >= tokens.size() || tokens[idx].value != "]")
             throw_error("Expected ']' after array index");
         idx++;
 
-        auto access_node = std::make_shared<EXPR>();
-        access_node->type = expression_type::ARRAY_ACCESS;
-        access_node->array_name = node->name;  
-        access_node->array_index = index_expr;
+        const NAME_ID array_name = exprs[node].name;
+        EXPR_ID access_node = new_expr(expression_type::ARRAY_ACCESS);
+        exprs[access_node].access.array = array_name;
+        exprs[access_node].access.index = index_expr;
 
         node = access_node;
     }
     return node;
 }
 
-std::shared_ptr<EXPR> AST::parse_array_literal(){
+// name(arg, ...), only the built-in functions of intrinsic_table can be called
+EXPR_ID AST::parse_intrinsic(std::string_view name){
+    INTRINSIC_KIND kind;
+    if(!find_intrinsic(name, kind)){
+        throw_error("Unknown function: " + std::string(name));
+    }
+    idx++; // skip '('
+
+    std::vector<EXPR_ID> args;
+    while(idx < tokens.size() && !(tokens[idx].type == TOKEN_TYPE::PAREN && tokens[idx].value == ")")){
+        args.push_back(parse_expression());
+        if(idx < tokens.size() && tokens[idx].type == TOKEN_TYPE::COMMA){
+            idx++;
+        }else{
+            break;
+        }
+    }
+
+    if(idx >= tokens.size() || tokens[idx].type != TOKEN_TYPE::PAREN || tokens[idx].value != ")"){
+        throw_error("Expected ')' after the arguments of " + std::string(name));
+    }
+    idx++;
+
+    const uint8_t arity = intrinsic_info(kind).arity;
+    if(args.size() != arity){
+        throw_error(std::string(name) + " takes " + std::to_string(arity) + (arity == 1 ? " argument" : " arguments"));
+    }
+
+    EXPR_ID node = new_expr(expression_type::INTRINSIC);
+    exprs[node].call.kind = kind;
+    exprs[node].call.args = push_list(expr_lists, args);
+    return node;
+}
+
+EXPR_ID AST::parse_array_literal(){
     if(tokens[idx].type!=TOKEN_TYPE::SPAREN || tokens[idx].value!="["){
-        return nullptr;
+        return NO_NODE;
     }
 
-    auto node = std::make_shared<EXPR>();
-    node->type=expression_type::ARRAY_LITERAL;
     idx++;
 
+    std::vector<EXPR_ID> elements;
     while(idx<tokens.size() && !(tokens[idx].type == TOKEN_TYPE::SPAREN && tokens[idx].value == "]")){
-        node->array_elements.push_back(parse_expression());
+        elements.push_back(parse_expression());
         if(idx<tokens.size()&&tokens[idx].type == TOKEN_TYPE::COMMA){idx++;}
     }
 
     if(idx>=tokens.size() || tokens[idx].value!="]"){
         throw_error("Expected ']' for array literal");
-        return nullptr;
+        return NO_NODE;
     }
 
     idx++;
+
+    EXPR_ID node = new_expr(expression_type::ARRAY_LITERAL);
+    exprs[node].array.elements = push_list(expr_lists, elements);
+    exprs[node].array.array = NO_NAME; // filled in by check_array_rules
     return node;
 }
 
-std::shared_ptr<EXPR> AST::parse_enum_body() {
+EXPR_ID AST::parse_enum_body() {
     if (tokens[idx].type != TOKEN_TYPE::SPAREN || tokens[idx].value != "[") {
         throw_error("Expected '[' token in enum content");
     }
 
-    auto node = std::make_shared<EXPR>();
-    node->type = expression_type::ENUM_LITERAL;
-
     idx++; // skip '['
     bool expect_comma = false;
+    std::vector<NAME_ID> members;
 
     while (idx < tokens.size() && !(tokens[idx].type == TOKEN_TYPE::SPAREN && tokens[idx].value == "]")) {
         const auto& tok = tokens[idx];
@@ -161,7 +309,7 @@ std::shared_ptr<EXPR> AST::parse_enum_body() {
                 throw_error("Expected ',' between enum identifiers");
             }
 
-            node->enum_elements.push_back(tok.value);
+            members.push_back(names.intern(tok.value));
             idx++;
             expect_comma = true;
         }
@@ -173,7 +321,7 @@ std::shared_ptr<EXPR> AST::parse_enum_body() {
             expect_comma = false;
         }
         else {
-            throw_error("Unexpected token in enum body: " + tok.value);
+            throw_error("Unexpected token in enum body: " + std::string(tok.value));
         }
     }
 
@@ -182,38 +330,53 @@ std::shared_ptr<EXPR> AST::parse_enum_body() {
     }
 
     idx++; // skip ']'
+
+    EXPR_ID node = new_expr(expression_type::ENUM_LITERAL);
+    exprs[node].members = push_list(name_lists, members);
     return node;
 }
 
 
-std::shared_ptr<EXPR> AST::parse_unary() {
+EXPR_ID AST::parse_unary() {
     if(idx < tokens.size() && tokens[idx].type == TOKEN_TYPE::OPERATOR &&
-       (tokens[idx].value == "+" || tokens[idx].value == "-" || tokens[idx].value == "!")) {
+       (tokens[idx].op == OPERATOR_KIND::ADD || tokens[idx].op == OPERATOR_KIND::SUB || tokens[idx].op == OPERATOR_KIND::NOT)) {
 
-        auto node = std::make_shared<EXPR>();
-        node->type = expression_type::UNARY;
-        node->unary_op = tokens[idx].value;
+        const OPERATOR_KIND op = tokens[idx].op;
         idx++;
-        node->unary_expr = parse_unary();
+        EXPR_ID operand = parse_unary();
+
+        EXPR_ID node = new_expr(expression_type::UNARY);
+        exprs[node].op = op;
+        exprs[node].operand = operand;
         return node;
     }
     return parse_factor();
 }
 
-std::shared_ptr<EXPR> AST::parse_factor() {
+EXPR_ID AST::parse_factor() {
     if(idx >= tokens.size()) throw_error("Unexpected end of input in factor");
     const auto& tok = tokens[idx];
-    auto node = std::make_shared<EXPR>();
+    EXPR_ID node = NO_NODE;
 
     if(tok.type == TOKEN_TYPE::NUMBER || tok.type == TOKEN_TYPE::STRING) {
-        node->type = expression_type::LITERAL;
-        node->value = tok.value;
-        node->literal_type = tok.type;
+        node = new_expr(expression_type::LITERAL);
+        EXPR& literal = exprs[node];
+        literal.literal_type = tok.type;
+        if(tok.type == TOKEN_TYPE::NUMBER){
+            parse_number(tok.value, literal);
+        }else{
+            literal.text = names.intern(tok.value);
+        }
         idx++;
-    } 
+    }
     else if(tok.type == TOKEN_TYPE::IDENTIFIER) {
-        node->type = expression_type::IDENTIFIER;
-        node->name = tok.value;
+        if(idx + 1 < tokens.size() && tokens[idx + 1].type == TOKEN_TYPE::PAREN && tokens[idx + 1].value == "("){
+            const std::string_view function = tok.value;
+            idx++;
+            return parse_intrinsic(function);
+        }
+
+        const NAME_ID name = names.intern(tok.value);
         idx++;
 
         if(idx<tokens.size() && tokens[idx].type == TOKEN_TYPE::ACCESS){
@@ -223,292 +386,443 @@ std::shared_ptr<EXPR> AST::parse_factor() {
                 throw_error("Expected enum value after '::'");
             }
 
-            node = std::make_shared<EXPR>();
-            node->type = expression_type::ENUM_ACCESS;
-            node->enum_name = tok.value;
-            node->enum_value = tokens[idx].value;
+            node = new_expr(expression_type::ENUM_ACCESS);
+            exprs[node].enum_access.enum_name = name;
+            exprs[node].enum_access.value = names.intern(tokens[idx].value);
             idx++;
             return node;
         }
 
+        node = new_expr(expression_type::IDENTIFIER);
+        exprs[node].name = name;
+
         if(idx<tokens.size()&&tokens[idx].type == TOKEN_TYPE::SPAREN && tokens[idx].value == "["){
             return parse_array_access(node);
         }
-    } 
+    }
     else if(tok.type == TOKEN_TYPE::PAREN && tok.value == "(") {
         idx++;
         node = parse_expression();
         if(idx >= tokens.size() || tokens[idx].type != TOKEN_TYPE::PAREN || tokens[idx].value != ")")
             throw_error("Expected ')' after expression");
         idx++;
-    } 
+    }
     else if(tok.type == TOKEN_TYPE::SPAREN && tok.value == "["){
         return parse_array_literal();
     }
     else {
-        throw_error("Unexpected token in factor: " + tok.value);
+        throw_error("Unexpected token in factor: " + std::string(tok.value));
     }
     return node;
 }
 
 // -------------------- Statement Parsing --------------------
-std::shared_ptr<STMT> AST::parse_statement() {
-    if(idx >= tokens.size()) return nullptr;
+STMT_ID AST::parse_statement() {
+    if(idx >= tokens.size()) return NO_NODE;
     const auto& tok = tokens[idx];
 
     if(tok.type == TOKEN_TYPE::KEYWORD) {
-        if(tok.value == "var") {return parse_var();}
+        if(tok.value == "var" || tok.value == "integer") {return parse_var();}
         else if(tok.value == "list") return parse_list();
         else if(tok.value == "if") return parse_if();
         else if(tok.value == "while") return parse_while();
-        else if(tok.value == "do") return parse_block_stmt();
+        else if(tok.value == "do") return parse_do();
         else if(tok.value == "enum") return parse_enum();
-        else { idx++; return nullptr; }
+        else { idx++; return NO_NODE; }
     }
     else if(tok.type == TOKEN_TYPE::IDENTIFIER) {
-        
-        auto lhs_expr = parse_factor(); 
-
-        if(idx < tokens.size() && tokens[idx].type == TOKEN_TYPE::OPERATOR && tokens[idx].value == "=") {
-            idx++; 
-            auto rhs_expr = parse_expression();
-
-            auto node = std::make_shared<STMT>();
-            node->type = stmt_type::ASSIGNMENT;
-            node->assign_expr = rhs_expr;
-
-            
-            if(lhs_expr->type == expression_type::IDENTIFIER) {
-                node->var_name = lhs_expr->name;
-            } else if(lhs_expr->type == expression_type::ARRAY_ACCESS) {
-                node->array_assign_expr = lhs_expr; 
+
+        EXPR_ID lhs_expr = parse_factor();
+
+        if(idx < tokens.size() && is_operator(tokens[idx], OPERATOR_KIND::ASSIGN)) {
+            idx++;
+            EXPR_ID rhs_expr = parse_expression();
+
+            STMT_ID node = new_stmt(stmt_type::ASSIGNMENT);
+            STMT& assignment = stmts[node];
+            assignment.assignment.value = rhs_expr;
+            assignment.assignment.name = NO_NAME;
+            assignment.assignment.target = NO_NODE;
+
+            const EXPR& lhs = exprs[lhs_expr];
+            if(lhs.type == expression_type::IDENTIFIER) {
+                assignment.assignment.name = lhs.name;
+            } else if(lhs.type == expression_type::ARRAY_ACCESS || lhs.type == expression_type::ARRAY_ACCESS_ND) {
+                assignment.assignment.target = lhs_expr;
             } else {
                 throw_error("Invalid LHS in assignment");
             }
 
             return node;
         } else {
-            throw_error("Unexpected identifier: " + tok.value);
+            throw_error("Unexpected identifier: " + std::string(tok.value));
         }
-    }else { 
+    }else {
         idx++;
-        return nullptr; 
+        return NO_NODE;
     }
-    return nullptr;
+    return NO_NODE;
 }
 
-std::shared_ptr<STMT> AST::parse_var() {
+// var x = ... / integer x = ... / var m(3, 4) / integer m(3, 4)
+STMT_ID AST::parse_var() {
+    const bool integer = tokens[idx].value == "integer";
     idx++;
-    auto node = std::make_shared<STMT>();
-    node->type = stmt_type::VAR_DECL;
 
     if(idx >= tokens.size() || tokens[idx].type != TOKEN_TYPE::IDENTIFIER)
-        throw_error("Expected variable name after 'var'");
-    node->var_name = tokens[idx].value;
+        throw_error(integer ? "Expected variable name after 'integer'" : "Expected variable name after 'var'");
+    const NAME_ID name = names.intern(tokens[idx].value);
     idx++;
 
-    if(idx >= tokens.size() || !(tokens[idx].type == TOKEN_TYPE::OPERATOR && tokens[idx].value == "="))
+    if(idx < tokens.size() && tokens[idx].type == TOKEN_TYPE::PAREN && tokens[idx].value == "("){
+        STMT_ID node = new_stmt(stmt_type::VAR_DECL);
+        stmts[node].var_decl.name = name;
+        stmts[node].var_decl.init = parse_array_extents(name, integer);
+        stmts[node].var_decl.integer = false; // the variable holds the array, the elements are the integers
+        return node;
+    }
+
+    if(idx >= tokens.size() || !is_operator(tokens[idx], OPERATOR_KIND::ASSIGN))
         throw_error("Expected '=' in var declaration");
     idx++;
 
-    node->init_expr = parse_expression();
+    EXPR_ID init = parse_expression();
+
+    STMT_ID node = new_stmt(stmt_type::VAR_DECL);
+    stmts[node].var_decl.name = name;
+    stmts[node].var_decl.init = init;
+    stmts[node].var_decl.integer = integer;
     return node;
 }
 
-std::shared_ptr<STMT> AST::parse_assignment() {
-    auto node = std::make_shared<STMT>();
-    node->type = stmt_type::ASSIGNMENT;
-    node->var_name = tokens[idx].value;
-    idx++;
+// (d1, d2, d3) after the name of a declared array, one extent per dimension
+EXPR_ID AST::parse_array_extents(NAME_ID array, bool integer){
+    idx++; // skip '('
+
+    std::vector<EXPR_ID> extents;
+    while(idx < tokens.size() && !(tokens[idx].type == TOKEN_TYPE::PAREN && tokens[idx].value == ")")){
+        extents.push_back(parse_expression());
+        if(idx < tokens.size() && tokens[idx].type == TOKEN_TYPE::COMMA){
+            idx++;
+        }else{
+            break;
+        }
+    }
 
-    if(idx >= tokens.size() || !(tokens[idx].type == TOKEN_TYPE::OPERATOR && tokens[idx].value == "="))
-        throw_error("Expected '=' in assignment");
+    if(idx >= tokens.size() || tokens[idx].type != TOKEN_TYPE::PAREN || tokens[idx].value != ")")
+        throw_error("Expected ')' after array extents");
     idx++;
 
-    node->assign_expr = parse_expression();
+    if(extents.empty() || extents.size() > MAX_RANK)
+        throw_error("Arrays need between 1 and " + std::to_string(MAX_RANK) + " extents");
+
+    EXPR_ID node = new_expr(expression_type::ARRAY_EXTENTS);
+    exprs[node].allocation.extents = push_list(expr_lists, extents);
+    exprs[node].allocation.array = array;
+    exprs[node].allocation.integer = integer;
     return node;
 }
 
-std::shared_ptr<STMT> AST::parse_list() {
+STMT_ID AST::parse_list() {
     idx++;
-    auto node = std::make_shared<STMT>();
-    node->type = stmt_type::LIST;
 
     if(idx >= tokens.size() || tokens[idx].type != TOKEN_TYPE::IDENTIFIER)
         throw_error("Expected identifier after 'list'");
-    node->list_var_name = tokens[idx].value;
+
+    STMT_ID node = new_stmt(stmt_type::LIST);
+    stmts[node].list.name = names.intern(tokens[idx].value);
     idx++;
     return node;
 }
 
-std::shared_ptr<STMT> AST::parse_enum() {
-    idx++; 
-    auto node = std::make_shared<STMT>();
-    node->type = stmt_type::ENUM;
+STMT_ID AST::parse_enum() {
+    idx++;
 
     if (idx >= tokens.size() || tokens[idx].type != TOKEN_TYPE::IDENTIFIER) {
         throw_error("Expected identifier after 'enum' declaration");
     }
-    node->enum_name = tokens[idx].value;
+    const NAME_ID name = names.intern(tokens[idx].value);
     idx++;
 
-    node->enum_body = parse_enum_body();
+    EXPR_ID body = parse_enum_body();
 
+    STMT_ID node = new_stmt(stmt_type::ENUM);
+    stmts[node].enum_decl.name = name;
+    stmts[node].enum_decl.body = body;
     return node;
 }
 
-std::shared_ptr<STMT> AST::parse_if() {
+STMT_ID AST::parse_if() {
     idx++;
-    auto node = std::make_shared<STMT>();
-    node->type = stmt_type::IF;
-    node->condition = parse_expression();
+    EXPR_ID condition = parse_expression();
 
-    if(idx >= tokens.size() || !(tokens[idx].type == TOKEN_TYPE::KEYWORD && tokens[idx].value == "do"))
+    if(idx >= tokens.size() || !is_keyword(tokens[idx], "do"))
         throw_error("Expected 'do' after if condition");
     idx++;
 
-    node->then_block = parse_block();
-    if(idx < tokens.size() && tokens[idx].type == TOKEN_TYPE::KEYWORD && tokens[idx].value == "else") {
-        node->has_else=true;
+    NODE_RANGE then_block = parse_block();
+    NODE_RANGE else_block{0, 0};
+    bool has_else = false;
+
+    if(idx < tokens.size() && is_keyword(tokens[idx], "else")) {
+        has_else=true;
         idx++;
-        node->else_block = parse_block();
+        else_block = parse_block();
     }
+
+    STMT_ID node = new_stmt(stmt_type::IF);
+    STMT& branch = stmts[node];
+    branch.has_else = has_else;
+    branch.branch.condition = condition;
+    branch.branch.then_block = then_block;
+    branch.branch.else_block = else_block;
     return node;
 }
 
-std::shared_ptr<STMT> AST::parse_while() {
+STMT_ID AST::parse_while() {
     idx++;
-    auto node = std::make_shared<STMT>();
-    node->type = stmt_type::WHILE;
-    node->condition = parse_expression();
+    EXPR_ID condition = parse_expression();
 
-    if(idx >= tokens.size() || !(tokens[idx].type == TOKEN_TYPE::KEYWORD && tokens[idx].value == "do"))
+    if(idx >= tokens.size() || !is_keyword(tokens[idx], "do"))
         throw_error("Expected 'do' after while condition");
     idx++;
 
-    node->then_block = parse_block();
+    NODE_RANGE body = parse_block();
+
+    STMT_ID node = new_stmt(stmt_type::WHILE);
+    stmts[node].loop.condition = condition;
+    stmts[node].loop.body = body;
+    return node;
+}
+
+// `do` opens a counted loop when it is followed by `i = start,`, anything else is a plain block
+STMT_ID AST::parse_do() {
+    if(idx + 2 < tokens.size() && tokens[idx + 1].type == TOKEN_TYPE::IDENTIFIER && is_operator(tokens[idx + 2], OPERATOR_KIND::ASSIGN)) {
+        const size_t do_idx = idx;
+        idx += 3;
+        parse_expression(); // a block starting with an assignment reads the same up to here
+        const bool counted = idx < tokens.size() && tokens[idx].type == TOKEN_TYPE::COMMA;
+        idx = do_idx;
+
+        if(counted) {
+            return parse_do_loop();
+        }
+    }
+    return parse_block_stmt();
+}
+
+STMT_ID AST::parse_do_loop() {
+    idx++; // skip 'do'
+    const NAME_ID counter = names.intern(tokens[idx].value);
+    idx += 2; // counter and '='
+
+    EXPR_ID start = parse_expression();
+    if(idx >= tokens.size() || tokens[idx].type != TOKEN_TYPE::COMMA)
+        throw_error("Expected ',' after do loop start");
+    idx++;
+
+    EXPR_ID end = parse_expression();
+    EXPR_ID step = NO_NODE;
+    if(idx < tokens.size() && tokens[idx].type == TOKEN_TYPE::COMMA) {
+        idx++;
+        step = parse_expression();
+    }
+
+    NODE_RANGE body = parse_block();
+    if(idx >= tokens.size() || !is_keyword(tokens[idx], "do") || !is_keyword(tokens[idx - 1], "end"))
+        throw_error("Expected 'end do' after do loop body");
+    idx++;
+
+    STMT_ID node = new_stmt(stmt_type::DO_LOOP);
+    STMT& loop = stmts[node];
+    loop.counted.counter = counter;
+    loop.counted.start = start;
+    loop.counted.end = end;
+    loop.counted.step = step;
+    loop.counted.body = body;
     return node;
 }
 
-std::shared_ptr<STMT> AST::parse_block_stmt() {
+STMT_ID AST::parse_block_stmt() {
     idx++;
-    auto node = std::make_shared<STMT>();
-    node->type = stmt_type::BLOCK;
-    node->then_block = parse_block();
+    NODE_RANGE block = parse_block();
+
+    STMT_ID node = new_stmt(stmt_type::BLOCK);
+    stmts[node].block = block;
     return node;
 }
 
 // -------------------- Block --------------------
-std::vector<std::shared_ptr<STMT>> AST::parse_block() {
-    std::vector<std::shared_ptr<STMT>> block;
+NODE_RANGE AST::parse_block() {
+    std::vector<STMT_ID> block;
     while(idx < tokens.size()) {
         if(tokens[idx].type == TOKEN_TYPE::KEYWORD && (tokens[idx].value == "end" || tokens[idx].value == "else"))
             break;
-        block.push_back(parse_statement());
+        STMT_ID stmt = parse_statement();
+        if(stmt != NO_NODE) block.push_back(stmt);
     }
-    if(idx < tokens.size() && tokens[idx].type == TOKEN_TYPE::KEYWORD && tokens[idx].value == "end")
+    if(idx < tokens.size() && is_keyword(tokens[idx], "end"))
         idx++;
-    return block;
+    return push_list(stmt_lists, block);
 }
 
-void AST::list_stmt(const std::shared_ptr<STMT>& stmt, int indent) {
-    if (!stmt) return;
+void AST::list_stmt(STMT_ID id, int indent) {
+    if (id == NO_NODE) return;
+    const STMT& stmt = stmts[id];
     std::string pad(indent * 2, ' ');
 
-    switch (stmt->type) {
+    auto list_block = [&](NODE_RANGE block){
+        for (uint32_t i = 0; i < block.count; ++i) list_stmt(stmt_lists[block.first + i], indent + 1);
+    };
+
+    switch (stmt.type) {
         case stmt_type::VAR_DECL:
-            std::cout << pad << "VarDecl: " << stmt->var_name << " = ";
-            list_expr(stmt->init_expr, 0);
+            std::cout << pad << (stmt.var_decl.integer ? "IntegerDecl: " : "VarDecl: ") << names[stmt.var_decl.name] << " = ";
+            list_expr(stmt.var_decl.init, 0);
             std::cout << "\n";
             break;
 
         case stmt_type::ASSIGNMENT:
-            std::cout << pad << "Assignment: " << stmt->var_name << " = ";
-            list_expr(stmt->assign_expr, 0);
+            std::cout << pad << "Assignment: " << names[stmt.assignment.name] << " = ";
+            list_expr(stmt.assignment.value, 0);
             std::cout << "\n";
             break;
 
         case stmt_type::LIST:
-            std::cout << pad << "List: " << stmt->list_var_name << "\n";
+            std::cout << pad << "List: " << names[stmt.list.name] << "\n";
             break;
 
         case stmt_type::IF:
             std::cout << pad << "If: ";
-            list_expr(stmt->condition, 0);
+            list_expr(stmt.branch.condition, 0);
             std::cout << "\n";
             std::cout << pad << "Then:\n";
-            for (const auto& s : stmt->then_block) list_stmt(s, indent + 1);
-            if (!stmt->else_block.empty()) {
+            list_block(stmt.branch.then_block);
+            if (stmt.branch.else_block.count != 0) {
                 std::cout << pad << "Else:\n";
-                for (const auto& s : stmt->else_block) list_stmt(s, indent + 1);
+                list_block(stmt.branch.else_block);
             }
             break;
 
         case stmt_type::WHILE:
             std::cout << pad << "While: ";
-            list_expr(stmt->condition, 0);
+            list_expr(stmt.loop.condition, 0);
             std::cout << "\n";
-            for (const auto& s : stmt->then_block) list_stmt(s, indent + 1);
+            list_block(stmt.loop.body);
             break;
 
         case stmt_type::BLOCK:
             std::cout << pad << "Block:\n";
-            for (const auto& s : stmt->then_block) list_stmt(s, indent + 1);
+            list_block(stmt.block);
             break;
 
-        case stmt_type::ENUM:
-            std::cout << pad << "Enum: " << stmt->enum_name << " [";
-            if (stmt->enum_body) {
-                for (size_t i = 0; i < stmt->enum_body->enum_elements.size(); ++i) {
-                    std::cout << stmt->enum_body->enum_elements[i];
-                    if (i != stmt->enum_body->enum_elements.size() - 1)
-                        std::cout << ", ";
-                }
+        case stmt_type::DO_LOOP:
+            std::cout << pad << "Do: " << names[stmt.counted.counter] << " = ";
+            list_expr(stmt.counted.start, 0);
+            std::cout << ", ";
+            list_expr(stmt.counted.end, 0);
+            if (stmt.counted.step != NO_NODE) {
+                std::cout << ", ";
+                list_expr(stmt.counted.step, 0);
+            }
+            std::cout << "\n";
+            list_block(stmt.counted.body);
+            break;
+
+        case stmt_type::ENUM: {
+            std::cout << pad << "Enum: " << names[stmt.enum_decl.name] << " [";
+            const NODE_RANGE members = exprs[stmt.enum_decl.body].members;
+            for (uint32_t i = 0; i < members.count; ++i) {
+                std::cout << names[name_lists[members.first + i]];
+                if (i != members.count - 1)
+                    std::cout << ", ";
             }
             std::cout << "]\n";
             break;
+        }
     }
 }
 
-void AST::list_expr(const std::shared_ptr<EXPR>& expr, int indent) {
-    if(!expr) return;
+void AST::list_expr(EXPR_ID id, int indent) {
+    if(id == NO_NODE) return;
+    const EXPR& expr = exprs[id];
     std::string pad(indent * 2, ' ');
 
-    switch(expr->type) {
+    switch(expr.type) {
         case expression_type::LITERAL:
-            std::cout << pad << "Literal(" << expr->value << ")";
+            std::cout << pad << "Literal(";
+            if(expr.literal_type == TOKEN_TYPE::NUMBER && expr.whole){
+                std::cout << expr.integer;
+            }else if(expr.literal_type == TOKEN_TYPE::NUMBER){
+                char buffer[32];
+                auto end = std::to_chars(buffer, buffer + sizeof(buffer), expr.number, std::chars_format::fixed).ptr;
+                if(end - buffer > 17){ // very large or very small, shortest round trip instead
+                    end = std::to_chars(buffer, buffer + sizeof(buffer), expr.number).ptr;
+                }
+                std::cout << std::string_view(buffer, end - buffer);
+            }else{
+                std::cout << names[expr.text];
+            }
+            std::cout << ")";
             break;
         case expression_type::IDENTIFIER:
-            std::cout << pad << "Identifier(" << expr->name << ")";
+            std::cout << pad << "Identifier(" << names[expr.name] << ")";
             break;
         case expression_type::UNARY:
-            std::cout << pad << "Unary(" << expr->unary_op << " ";
-            list_expr(expr->unary_expr, 0);
+            std::cout << pad << "Unary(" << operator_info(expr.op).spelling << " ";
+            list_expr(expr.operand, 0);
             std::cout << ")";
             break;
         case expression_type::BINARY:
             std::cout << pad << "Binary(";
-            list_expr(expr->left, 0);
-            std::cout << " " << expr->binary_op << " ";
-            list_expr(expr->right, 0);
+            list_expr(expr.binary.left, 0);
+            std::cout << " " << operator_info(expr.op).spelling << " ";
+            list_expr(expr.binary.right, 0);
             std::cout << ")";
             break;
         case expression_type::ARRAY_LITERAL:
             std::cout << pad << "ArrayLiteral([";
-            for(size_t i = 0; i < expr->array_elements.size(); ++i) {
-                list_expr(expr->array_elements[i], 0);
-                if(i != expr->array_elements.size() - 1)
+            for(uint32_t i = 0; i < expr.array.elements.count; ++i) {
+                list_expr(expr_lists[expr.array.elements.first + i], 0);
+                if(i != expr.array.elements.count - 1)
                     std::cout << ", ";
             }
             std::cout << "])";
             break;
         case expression_type::ARRAY_ACCESS:
-            std::cout << pad << "ArrayAccess(" << expr->array_name << "[";
-            list_expr(expr->array_index, 0);
+            std::cout << pad << "ArrayAccess(" << names[expr.access.array] << "[";
+            list_expr(expr.access.index, 0);
             std::cout << "])";
             break;
         case expression_type::ENUM_ACCESS:
-            std::cout << pad << "EnumAccess(" << expr->enum_name << "::" << expr->enum_value << ")";
+            std::cout << pad << "EnumAccess(" << names[expr.enum_access.enum_name] << "::" << names[expr.enum_access.value] << ")";
+            break;
+        case expression_type::ARRAY_EXTENTS:
+            std::cout << pad << (expr.allocation.integer ? "IntegerArray(" : "Array(");
+            for(uint32_t i = 0; i < expr.allocation.extents.count; ++i) {
+                list_expr(expr_lists[expr.allocation.extents.first + i], 0);
+                if(i != expr.allocation.extents.count - 1)
+                    std::cout << ", ";
+            }
+            std::cout << ")";
+            break;
+        case expression_type::ARRAY_ACCESS_ND:
+            std::cout << pad << "ArrayAccess(" << names[expr.access_nd.array] << "[";
+            for(uint32_t i = 0; i < expr.access_nd.subscripts.count; ++i) {
+                list_expr(expr_lists[expr.access_nd.subscripts.first + i], 0);
+                if(i != expr.access_nd.subscripts.count - 1)
+                    std::cout << ", ";
+            }
+            std::cout << "])";
+            break;
+        case expression_type::INTRINSIC:
+            std::cout << pad << "Intrinsic(" << intrinsic_info(expr.call.kind).spelling << "(";
+            for(uint32_t i = 0; i < expr.call.args.count; ++i) {
+                list_expr(expr_lists[expr.call.args.first + i], 0);
+                if(i != expr.call.args.count - 1)
+                    std::cout << ", ";
+            }
+            std::cout << "))";
             break;
 
         default:
@@ -519,14 +833,14 @@ void AST::list_expr(const std::shared_ptr<EXPR>& expr, int indent) {
 
 void AST::list() {
     std::cout << "Program: " << this->program_name << "\n";
-    for(const auto& stmt : statements) {
-        list_stmt(stmt, 0);
+    for(uint32_t i = 0; i < statements.count; ++i) {
+        list_stmt(stmt_lists[statements.first + i], 0);
     }
 }
 
 // -------------------- Parse top-level --------------------
 void AST::parse() {
-    
+
     if(idx >= tokens.size() || !is_keyword(tokens[idx], "program")){
         throw_error("Expected 'program' at the beginning");
     }
@@ -540,7 +854,7 @@ void AST::parse() {
     const int prev_idx=idx;
 
     while(idx<tokens.size()-1){
-        
+
         if(tokens[idx].value == "program" && tokens[idx].type == TOKEN_TYPE::KEYWORD){
             throw_error("Only one program is allowed per file!");
         }
@@ -552,523 +866,1460 @@ void AST::parse() {
     this->program_name = tokens[idx].value;
     idx++;
 
+    // rough upper bounds, a statement or expression node needs at least one token
+    this->exprs.reserve(tokens.size() / 2);
+    this->stmts.reserve(tokens.size() / 4);
+
+    std::vector<STMT_ID> top_level;
+
     while(idx < tokens.size()) {
         if(is_keyword(tokens[idx], "end")) {
             idx++;
             if(idx < tokens.size() && is_keyword(tokens[idx], "program")) {
                 idx++;
                 if(idx < tokens.size() && tokens[idx].type == TOKEN_TYPE::IDENTIFIER) {
-                    throw_error("Multiple programs detected: '" + tokens[idx].value + "'");
-                } 
+                    throw_error("Multiple programs detected: '" + std::string(tokens[idx].value) + "'");
+                }
             }else{
                 throw_error("Expected 'end program' sequence");
             }
             break; // End of program
         }
 
-        auto stmt = parse_statement();
-        if(stmt) statements.push_back(stmt);
+        STMT_ID stmt = parse_statement();
+        if(stmt != NO_NODE) top_level.push_back(stmt);
     }
 
-   
+    this->statements = push_list(stmt_lists, top_level);
 }
 
-// CODEGEN 
+// CODEGEN
 
 void AST::parse_scope_start(){
-    
-    int last_var_index = var_codification.empty() ? -1 : var_codification.size() - 1;
-    scope_var_count.push(last_var_index);
-    
+
+    this->scopes.push_back({static_cast<uint16_t>(this->next_slot), {}});
+
 }
 
 void AST::parse_scope_end(){
 
-    if(this->scope_var_count.empty()){
+    if(this->scopes.empty()){
         throw_error("No open scope to end");
     }
 
-    int vars_before_scope = this->scope_var_count.top();
-    this->scope_var_count.pop();
+    // only the names declared in this scope are dropped, so scope exit costs O(scope size)
+    for(NAME_ID name : this->scopes.back().names){
 
-    for(auto it = this->var_codification.begin(); it != this->var_codification.end(); ){
-        
-        if(this->enum_value_to_enums.find(it->first) != this->enum_value_to_enums.end()){
-            
-            // this->enum_map.erase(this->enum_name_to_uint8[it->first]); // don't erase this since it'll later be translated
-            this->enum_name_to_uint8.erase(it->first);
-            this->enum_value_to_enums.erase(it->first);
-        }
-        
-        if(it->second > vars_before_scope){
-            it = this->var_codification.erase(it);
-        } else {
-            ++it;
+        if(this->enum_value_to_enums.find(name) != this->enum_value_to_enums.end()){
+
+            // this->enum_map.erase(this->enum_name_to_uint8[name]); // don't erase this since it'll later be translated
+            this->enum_name_to_uint8.erase(name);
+            this->enum_value_to_enums.erase(name);
         }
+
+        this->var_codification[name] = NO_SLOT;
     }
+
+    this->next_slot = this->scopes.back().first_slot;
+    this->scopes.pop_back();
 }
 
-void AST::check_array_rules() {
-    for (auto& stmt : statements) {
-        check_stmt_array_rules(stmt, false,"");
+uint16_t AST::declare_variable(NAME_ID name){
+
+    uint16_t slot = this->reserve_slots(1);
+    this->var_codification[name] = slot;
+
+    if(!this->scopes.empty()){
+        this->scopes.back().names.push_back(name);
+    }
+
+    return slot;
+}
+
+// consecutive slots that belong to no name (cached loop bounds), handed back when the scope closes
+uint16_t AST::reserve_slots(uint32_t count){
+
+    if(this->next_slot + count > UINT16_MAX + 1){
+        throw_error("Too many variables alive at once, limit is " + std::to_string(UINT16_MAX + 1));
     }
+
+    uint16_t first = this->next_slot;
+    this->next_slot += count;
+    return first;
 }
 
+void AST::check_array_rules() {
+    check_block_array_rules(this->statements);
+}
+
+void AST::check_block_array_rules(NODE_RANGE block) {
+    for (uint32_t i = 0; i < block.count; ++i) {
+        check_stmt_array_rules(stmt_lists[block.first + i]);
+    }
+}
 
-void AST::check_stmt_array_rules(const std::shared_ptr<STMT>& stmt, bool in_assignment_or_var, const std::string& current_var) {
-    if (!stmt) return;
+void AST::check_stmt_array_rules(STMT_ID id) {
+    const STMT& stmt = stmts[id];
 
-    switch (stmt->type) {
+    switch (stmt.type) {
         case stmt_type::VAR_DECL:
-           
-            check_expr_array_rules(stmt->init_expr, true, stmt->var_name);
+            check_expr_array_rules(stmt.var_decl.init, true, stmt.var_decl.name);
             break;
         case stmt_type::ASSIGNMENT:
-           
-            check_expr_array_rules(stmt->assign_expr, true, stmt->var_name);
+            check_expr_array_rules(stmt.assignment.value, true, stmt.assignment.name);
             break;
         case stmt_type::IF:
-            check_expr_array_rules(stmt->condition, false, "");
-            for (auto& s : stmt->then_block) check_stmt_array_rules(s, false, "");
-            for (auto& s : stmt->else_block) check_stmt_array_rules(s, false, "");
+            check_expr_array_rules(stmt.branch.condition, false, NO_NAME);
+            check_block_array_rules(stmt.branch.then_block);
+            check_block_array_rules(stmt.branch.else_block);
             break;
         case stmt_type::WHILE:
-            check_expr_array_rules(stmt->condition, false, "");
-            for (auto& s : stmt->then_block) check_stmt_array_rules(s, false, "");
+            check_expr_array_rules(stmt.loop.condition, false, NO_NAME);
+            check_block_array_rules(stmt.loop.body);
             break;
         case stmt_type::BLOCK:
-            for (auto& s : stmt->then_block) check_stmt_array_rules(s, false, "");
+            check_block_array_rules(stmt.block);
             break;
-        case stmt_type::LIST:
+        case stmt_type::DO_LOOP:
+            check_expr_array_rules(stmt.counted.start, false, NO_NAME);
+            check_expr_array_rules(stmt.counted.end, false, NO_NAME);
+            check_expr_array_rules(stmt.counted.step, false, NO_NAME);
+            check_block_array_rules(stmt.counted.body);
+            break;
+        default:
             break;
     }
 }
 
-void AST::check_expr_array_rules(const std::shared_ptr<EXPR>& expr, bool in_assignment_or_var, const std::string& current_var) {
-    if (!expr) return;
+void AST::check_expr_array_rules(EXPR_ID id, bool in_assignment_or_var, NAME_ID current_var) {
+    if (id == NO_NODE) return;
+    EXPR& expr = exprs[id];
 
-    switch (expr->type) {
-        case expression_type::ARRAY_LITERAL:
+    switch (expr.type) {
+        case expression_type::ARRAY_LITERAL: {
             if (!in_assignment_or_var) {
                 throw_error("Array literals are only allowed in variable declarations or assignments");
             }
-            
-            expr->array_name = current_var;
 
-            if(expr->array_elements.empty()){
+            expr.array.array = current_var;
+
+            const NODE_RANGE elements = expr.array.elements;
+            if(elements.count == 0){
                 throw_error("Empty arrays are not allowed");
             }
 
-            for (auto& el : expr->array_elements) {
-                if (el->type == expression_type::ARRAY_LITERAL) {
+            for (uint32_t i = 0; i < elements.count; ++i) {
+                const EXPR_ID el = expr_lists[elements.first + i];
+                if (exprs[el].type == expression_type::ARRAY_LITERAL) {
                     throw_error("Nested array literals are not allowed");
                 }
-                check_expr_array_rules(el, true, current_var); 
+                check_expr_array_rules(el, true, current_var);
             }
             break;
+        }
         case expression_type::ARRAY_ACCESS:
-            check_expr_array_rules(expr->array_index, false, "");
+            check_expr_array_rules(expr.access.index, false, NO_NAME);
             break;
         case expression_type::UNARY:
-            check_expr_array_rules(expr->unary_expr, false, "");
+            check_expr_array_rules(expr.operand, false, NO_NAME);
             break;
         case expression_type::BINARY:
-            check_expr_array_rules(expr->left, false, "");
-            check_expr_array_rules(expr->right, false, "");
-            
+            check_expr_array_rules(expr.binary.left, false, NO_NAME);
+            check_expr_array_rules(expr.binary.right, false, NO_NAME);
             break;
-        case expression_type::IDENTIFIER:
-        case expression_type::LITERAL:
+        case expression_type::INTRINSIC:
+            for (uint32_t i = 0; i < expr.call.args.count; ++i) {
+                check_expr_array_rules(expr_lists[expr.call.args.first + i], false, NO_NAME);
+            }
+            break;
+        case expression_type::ARRAY_EXTENTS:
+            for (uint32_t i = 0; i < expr.allocation.extents.count; ++i) {
+                check_expr_array_rules(expr_lists[expr.allocation.extents.first + i], false, NO_NAME);
+            }
+            break;
+        case expression_type::ARRAY_ACCESS_ND:
+            for (uint32_t i = 0; i < expr.access_nd.subscripts.count; ++i) {
+                check_expr_array_rules(expr_lists[expr.access_nd.subscripts.first + i], false, NO_NAME);
+            }
             break;
         default:
             break;
     }
 }
 
-void AST::codegen_expr(std::shared_ptr<EXPR>& expr){
-    if(!expr){return;}
-    
-    switch (expr->type){
-        case expression_type::LITERAL:
-        {
-            if(expr->literal_type == TOKEN_TYPE::STRING){
-                
-                // alloc new string in string pool
-
-                if(this->string_hasher.string_to_hash.find(expr->value)==this->string_hasher.string_to_hash.end()){
-                    uint16_t string_hash_id = this->string_hasher.string_to_hash.size();
-                    this->string_hasher.string_to_hash[expr->value] = string_hash_id;
-                    this->bytecode+="LOADSTRING "+std::to_string(string_hash_id) + "\n";
-                }else{
-                    uint16_t string_hash_id = this->string_hasher.string_to_hash[expr->value];
-                    this->bytecode+="LOADSTRING " + std::to_string(string_hash_id) + "\n";
-                }
-            }else{
-                // simply push number
-                this->bytecode+="PUSH " + expr->value + "\n";
-            }
+// -------------------- Constant Folding --------------------
+// Only folds what evaluates the same way the VM would evaluate it, anything that would
+// raise a runtime error or depends on VM quirks (mixed types, string arithmetic) is left alone.
+// Folded nodes are rewritten in place, their old children simply stay unreferenced in the arena.
+
+static void set_number_literal(EXPR& expr, double value){
+    expr.type = expression_type::LITERAL;
+    expr.literal_type = TOKEN_TYPE::NUMBER;
+    expr.op = OPERATOR_KIND::NONE;
+    expr.whole = false;
+    expr.number = value;
+}
 
-            break;
-        }
+static inline bool is_literal(const EXPR& expr, TOKEN_TYPE type){
+    return expr.type == expression_type::LITERAL && expr.literal_type == type;
+}
 
-        case expression_type::ENUM_ACCESS:{
+// truthiness of a folded condition the way GOTO_IF_FALSE sees it, false when it isn't a constant
+bool AST::constant_truth(EXPR_ID id, bool& truth) const {
+    if(id == NO_NODE){ return false; }
+    const EXPR& expr = exprs[id];
 
-            if(this->var_codification.find(expr->enum_name) == this->var_codification.end()){
-                throw_error("Invalid enum of name: " + expr->enum_name);
-            }
+    if(is_literal(expr, TOKEN_TYPE::NUMBER)){
+        truth = literal_number(expr) != 0;
+        return true;
+    }
+    if(is_literal(expr, TOKEN_TYPE::STRING)){
+        truth = !names[expr.text].empty();
+        return true;
+    }
+    return false;
+}
 
-            if(std::find(this->enum_value_to_enums[expr->enum_name].begin(),this->enum_value_to_enums[expr->enum_name].end(),expr->enum_value) == this->enum_value_to_enums[expr->enum_name].end()){
-                throw_error("Enum object: " + expr->enum_value + " doesn't exist in: " + expr->enum_name + " enum");
-            }
+void AST::fold_expr(EXPR_ID id){
+    if(id == NO_NODE){ return; }
 
-            uint16_t enum_index = std::distance(this->enum_value_to_enums[expr->enum_name].begin(), std::find(this->enum_value_to_enums[expr->enum_name].begin(),this->enum_value_to_enums[expr->enum_name].end(),expr->enum_value));
-            // also have to add enum id from where it comes 
+    switch(exprs[id].type){
+        case expression_type::UNARY: {
+            const EXPR_ID operand_id = exprs[id].operand;
+            fold_expr(operand_id);
 
-            this->bytecode+="PUSH "+std::to_string(this->enum_name_to_uint8[expr->enum_name])+"\n";
-            this->bytecode+="PUSH_ENUM_VALUE " + std::to_string(enum_index) + "\n";
+            const EXPR operand = exprs[operand_id];
+            if(!is_literal(operand, TOKEN_TYPE::NUMBER)){
+                break;
+            }
 
+            EXPR& expr = exprs[id];
+            if(expr.op == OPERATOR_KIND::ADD){
+                expr = operand;
+            }else if(expr.op == OPERATOR_KIND::SUB && operand.whole && operand.integer != INT64_MIN){
+                expr = operand; // -9007199254740993 stays exact
+                expr.integer = -operand.integer;
+            }else if(expr.op == OPERATOR_KIND::SUB){
+                set_number_literal(expr, -literal_number(operand));
+            }else if(expr.op == OPERATOR_KIND::NOT){
+                set_number_literal(expr, !literal_number(operand));
+            }
             break;
         }
 
-        case expression_type::ARRAY_ACCESS:{
-
-            if(this->var_codification.find(expr->array_name) == this->var_codification.end()) {
-                throw_error("Invalid variable of name: " + expr->array_name);
+        case expression_type::BINARY: {
+            fold_expr(exprs[id].binary.left);
+            fold_expr(exprs[id].binary.right);
+
+            // interning below may grow the name table but never the expression arena
+            EXPR& expr = exprs[id];
+            const EXPR& left = exprs[expr.binary.left];
+            const EXPR& right = exprs[expr.binary.right];
+            const OPERATOR_KIND op = expr.op;
+
+            if(op == OPERATOR_KIND::CONCAT){
+                // the parser only accepts string literals on both sides
+                const NAME_ID text = names.intern(names[left.text] + names[right.text]);
+                expr.type = expression_type::LITERAL;
+                expr.literal_type = TOKEN_TYPE::STRING;
+                expr.op = OPERATOR_KIND::NONE;
+                expr.text = text;
                 break;
             }
 
-            if(this->array_codification.find(expr->array_name) == this->array_codification.end()){
-                throw_error("Invalid array of name: " + expr->array_name);
+            // whole numbers stay exact past 2^53, a result that overflows int64 is left to the VM,
+            // which wraps it with ADD_INT or rounds it with OP depending on where it's used
+            if(is_literal(left, TOKEN_TYPE::NUMBER) && left.whole && is_literal(right, TOKEN_TYPE::NUMBER) && right.whole &&
+               (op == OPERATOR_KIND::ADD || op == OPERATOR_KIND::SUB || op == OPERATOR_KIND::MUL)){
+                int64_t value;
+                const bool overflow = op == OPERATOR_KIND::ADD ? __builtin_add_overflow(left.integer, right.integer, &value) :
+                                      op == OPERATOR_KIND::SUB ? __builtin_sub_overflow(left.integer, right.integer, &value) :
+                                                                 __builtin_mul_overflow(left.integer, right.integer, &value);
+                if(!overflow){
+                    set_number_literal(expr, 0);
+                    expr.whole = true;
+                    expr.integer = value;
+                }
                 break;
             }
 
-            this->codegen_expr(expr->array_index);
-
-            this->bytecode+="LOAD_ARRAY_AT " + std::to_string(this->array_codification[expr->array_name]) + "\n"; // loads array at top index
+            if(is_literal(left, TOKEN_TYPE::NUMBER) && is_literal(right, TOKEN_TYPE::NUMBER)){
+                const double l = literal_number(left);
+                const double r = literal_number(right);
+
+                switch(op){
+                    case OPERATOR_KIND::ADD: set_number_literal(expr, l + r); break;
+                    case OPERATOR_KIND::SUB: set_number_literal(expr, l - r); break;
+                    case OPERATOR_KIND::MUL: set_number_literal(expr, l * r); break;
+                    case OPERATOR_KIND::DIV: set_number_literal(expr, l / r); break;
+                    case OPERATOR_KIND::EQ:  set_number_literal(expr, l == r); break;
+                    case OPERATOR_KIND::NE:  set_number_literal(expr, l != r); break;
+                    case OPERATOR_KIND::LT:  set_number_literal(expr, l < r); break;
+                    case OPERATOR_KIND::GT:  set_number_literal(expr, l > r); break;
+                    case OPERATOR_KIND::LE:  set_number_literal(expr, l <= r); break;
+                    case OPERATOR_KIND::GE:  set_number_literal(expr, l >= r); break;
+                    case OPERATOR_KIND::AND: set_number_literal(expr, l != 0 && r != 0); break;
+                    case OPERATOR_KIND::OR:  set_number_literal(expr, l != 0 || r != 0); break;
+                    default: break;
+                }
+                break;
+            }
 
+            // interned strings are equal exactly when their ids are
+            if(is_literal(left, TOKEN_TYPE::STRING) && is_literal(right, TOKEN_TYPE::STRING)){
+                if(op == OPERATOR_KIND::EQ)      set_number_literal(expr, left.text == right.text);
+                else if(op == OPERATOR_KIND::NE) set_number_literal(expr, left.text != right.text);
+            }
             break;
         }
 
-        case expression_type::ARRAY_LITERAL:{
-            
-            for(auto& Expr:expr->array_elements){ // write all array elements
-                this->codegen_expr(Expr); 
+        case expression_type::ARRAY_LITERAL: {
+            const NODE_RANGE elements = exprs[id].array.elements;
+            for(uint32_t i = 0; i < elements.count; ++i){
+                fold_expr(expr_lists[elements.first + i]);
             }
+            break;
+        }
 
-            const std::string& array_expression_name = expr->array_name;
+        case expression_type::ARRAY_ACCESS:
+            fold_expr(exprs[id].access.index);
+            break;
 
-            if(this->var_codification.find(array_expression_name) == this->var_codification.end() && this->variables_in_declaration_proccess.find(array_expression_name)==this->variables_in_declaration_proccess.end()){
-                throw_error("Invalid array variable of name: " + array_expression_name);
+        case expression_type::INTRINSIC: {
+            const NODE_RANGE args = exprs[id].call.args;
+            for(uint32_t i = 0; i < args.count; ++i){
+                fold_expr(expr_lists[args.first + i]);
             }
+            break;
+        }
 
-            if(this->array_codification.find(array_expression_name)==this->array_codification.end()){
-                // assign new array 
-                if(this->array_codification.size()-1 == UINT8_MAX){
-                    throw_error("Too many arrays declared in program!");
-                }
-
-                uint8_t assignee_idx = this->array_codification.size();
-
-                this->array_codification[array_expression_name] = assignee_idx;
-
-                this->bytecode+="LOAD_ARRAY " + std::to_string(this->array_codification[array_expression_name]) + "\n";
-            }else{
-                this->bytecode+="LOAD_ARRAY " + std::to_string(this->array_codification[array_expression_name]) + "\n"; // overwrite assignee array.
+        case expression_type::ARRAY_EXTENTS: {
+            const NODE_RANGE extents = exprs[id].allocation.extents;
+            for(uint32_t i = 0; i < extents.count; ++i){
+                fold_expr(expr_lists[extents.first + i]);
             }
+            break;
+        }
 
+        case expression_type::ARRAY_ACCESS_ND: {
+            const NODE_RANGE subscripts = exprs[id].access_nd.subscripts;
+            for(uint32_t i = 0; i < subscripts.count; ++i){
+                fold_expr(expr_lists[subscripts.first + i]);
+            }
             break;
         }
 
-        case expression_type::UNARY:{
+        default:
+            break;
+    }
+}
+
+void AST::fold_block(NODE_RANGE block){
+    for(uint32_t i = 0; i < block.count; ++i){
+        fold_stmt(stmt_lists[block.first + i]);
+    }
+}
 
-            this->codegen_expr(expr->unary_expr);
+void AST::fold_stmt(STMT_ID id){
+    STMT& stmt = stmts[id]; // folding never adds statements, the reference stays valid
 
-            switch(expr->unary_op[0]){
-                case '+':
-                    break;
-                case '!':
-                    this->bytecode += "NOT\n";
-                    break;
-                case '-':
-                    this->bytecode+="NEG\n";
-                    break;
-                default:
-                    throw_error(std::string("Invalid unary op: '" + expr->unary_op[0] + '\''));
-                    break;
-            }
+    switch(stmt.type){
+        case stmt_type::VAR_DECL:
+            fold_expr(stmt.var_decl.init);
+            break;
 
+        case stmt_type::ASSIGNMENT:
+            fold_expr(stmt.assignment.value);
+            fold_expr(stmt.assignment.target); // the index of x[i] = ..., NO_NODE is skipped
             break;
-        }
 
-        case expression_type::IDENTIFIER: {
-            const std::string& var_name = expr->name;
+        case stmt_type::BLOCK:
+            fold_block(stmt.block);
+            break;
+
+        case stmt_type::DO_LOOP:
+            fold_expr(stmt.counted.start);
+            fold_expr(stmt.counted.end);
+            fold_expr(stmt.counted.step);
+            fold_block(stmt.counted.body);
+            break;
 
-            if(this->var_codification.find(var_name) == this->var_codification.end()) {
-                throw_error("Invalid variable of name: " + var_name);
+        case stmt_type::IF: {
+            fold_expr(stmt.branch.condition);
+            fold_block(stmt.branch.then_block);
+            fold_block(stmt.branch.else_block);
+
+            bool truth;
+            if(!constant_truth(stmt.branch.condition, truth)){
                 break;
             }
 
-            uint16_t var_code = var_codification[var_name];
-            this->bytecode += "LOAD " + std::to_string(var_code) + "\n";
+            // only the taken arm survives, as a plain scope block
+            const NODE_RANGE taken = truth ? stmt.branch.then_block : stmt.branch.else_block;
+            stmt.type = stmt_type::BLOCK;
+            stmt.has_else = false;
+            stmt.block = taken;
             break;
         }
 
+        case stmt_type::WHILE: {
+            fold_expr(stmt.loop.condition);
+            fold_block(stmt.loop.body);
 
-        case expression_type::BINARY:{
-
-            const std::string& op = expr->binary_op;
-
-            if(!(op == "concat")){
-                codegen_expr(expr->left);
-                codegen_expr(expr->right);
-            }
-
-            if(op == "+"){
-                this->bytecode+="OP +\n";
-            }else if(op == "-"){
-                this->bytecode+="OP -\n";
-            }else if(op == "*"){
-                this->bytecode+="OP *\n";
-            }else if(op == "/"){
-                this->bytecode+="OP /\n";
-            }else if(op == "=="){
-                this->bytecode+="OP =\n";
-            }else if(op=="!="){
-                this->bytecode+="OP ~\n";
-            }else if(op == "<="){
-                this->bytecode+="OP [\n";
-            }else if(op == ">="){
-                this->bytecode+="OP ]\n";
-            }else if(op == ">"){
-                this->bytecode+="OP >\n";
-            }else if(op == "<"){
-                this->bytecode+="OP <\n";
-            }else if(op == "and"){
-                this->bytecode+="AND\n";
-            }else if(op == "or"){
-                this->bytecode+="OR\n";
-            }else if(op == "concat"){
-                
-                const std::string &Lstring_value = expr->left->value;
-                const std::string &Rstring_value = expr->right->value;
-
-                const std::string concatenated = Lstring_value + Rstring_value;
-
-                if(this->string_hasher.string_to_hash.find(concatenated)!=this->string_hasher.string_to_hash.end()){
-                    this->bytecode+="LOADSTRING " + std::to_string(this->string_hasher.string_to_hash[concatenated]) + "\n";
-                }else{
-                    // alloc new string id.
-                    uint16_t string_hash_id = this->string_hasher.string_to_hash.size();
-                    this->string_hasher.string_to_hash[concatenated] = string_hash_id;
-                    this->bytecode+="LOADSTRING "+std::to_string(string_hash_id) + "\n";
-                }
+            bool truth;
+            if(!constant_truth(stmt.loop.condition, truth)){
+                break;
             }
 
+            if(!truth){
+                stmt.type = stmt_type::BLOCK; // never entered
+                stmt.block = {0, 0};
+            }else{
+                stmt.loop.condition = NO_NODE; // loops forever, codegen drops the test
+            }
             break;
         }
 
         default:
-            throw_error("Invalid expression type detected!");
             break;
     }
 }
 
-void AST::codegen(std::shared_ptr<STMT>&stmt){
-    
-    if(!stmt){ return; }
+void AST::fold_constants(){
+    fold_block(this->statements);
+}
 
-    switch(stmt->type){
-        case stmt_type::VAR_DECL:{
+// -------------------- Type Inference --------------------
+// Walks the program the way codegen will, with the same scopes, and joins every value stored into
+// a variable into the type of its declaration. Loops can feed a later store back into an earlier
+// read, so the walk repeats until no declaration changes anymore; the lattice is tiny, that takes
+// a couple of passes at most. Codegen then emits the *_NUM opcodes wherever both operands are NUMBER
+// and the *_INT ones wherever they are INTEGER, or one is and the other is a whole number literal.
+
+void AST::infer_types(){
+    this->expr_types.assign(this->exprs.size(), STATIC_TYPE::UNKNOWN);
+    this->binding_types.assign(this->stmts.size(), STATIC_TYPE::UNKNOWN);
+
+    do{
+        this->types_changed = false;
+        this->visible_bindings.assign(this->names.size(), NO_NODE);
+        this->inference_scopes.clear();
+        this->infer_block(this->statements);
+    }while(this->types_changed);
+
+    this->visible_bindings = {};
+}
 
-            const std::string& var_name = stmt->var_name;
-            if(this->var_codification.find(var_name) != this->var_codification.end()){
-                throw_error("Variable already declared: " + var_name);
-            }
+void AST::infer_scope_start(){
+    this->inference_scopes.emplace_back();
+}
 
-            uint16_t var_code = var_codification.size();
-            this->variables_in_declaration_proccess[var_name]=true;
-            this->codegen_expr(stmt->init_expr);
-            this->variables_in_declaration_proccess.erase(var_name);
-            this->var_codification[var_name] = var_code;
-            this->bytecode += "STORE " + std::to_string(var_code) + "\n";
-            
-            break;
+void AST::infer_scope_end(){
+    for(NAME_ID name : this->inference_scopes.back()){
+        this->visible_bindings[name] = NO_NODE;
+    }
+    this->inference_scopes.pop_back();
+}
+
+void AST::infer_store(NAME_ID name, STATIC_TYPE type){
+    if(name == NO_NAME || this->visible_bindings[name] == NO_NODE){
+        return; // codegen reports the undeclared variable
+    }
+
+    const STMT& declaration = stmts[this->visible_bindings[name]];
+    if(declaration.type == stmt_type::VAR_DECL && declaration.var_decl.integer){
+        type = STATIC_TYPE::INTEGER; // STORE_INT converts or stops the program
+    }
+
+    STATIC_TYPE& binding = this->binding_types[this->visible_bindings[name]];
+    const STATIC_TYPE joined = join_types(binding, type);
+    if(joined != binding){
+        binding = joined;
+        this->types_changed = true;
+    }
+}
+
+bool AST::is_number(EXPR_ID id) const {
+    return id != NO_NODE && this->expr_types[id] == STATIC_TYPE::NUMBER;
+}
+
+// literals that PUSH_INT can carry exactly
+static inline bool is_integer_literal(const EXPR& expr){
+    return expr.type == expression_type::LITERAL && expr.literal_type == TOKEN_TYPE::NUMBER &&
+           (expr.whole || (std::trunc(expr.number) == expr.number && std::fabs(expr.number) <= 0x1p53));
+}
+
+bool AST::is_integer(EXPR_ID id) const {
+    return id != NO_NODE && this->expr_types[id] == STATIC_TYPE::INTEGER;
+}
+
+// integer arithmetic needs one integer operand, a whole number literal on the other side follows it
+bool AST::integer_operands(EXPR_ID left, EXPR_ID right) const {
+    const bool left_fits = this->is_integer(left) || is_integer_literal(exprs[left]);
+    const bool right_fits = this->is_integer(right) || is_integer_literal(exprs[right]);
+    return left_fits && right_fits && (this->is_integer(left) || this->is_integer(right));
+}
+
+// arithmetic with an array on either side, computed element by element through ARRAY_OP
+bool AST::is_array_op(EXPR_ID id) const {
+    if(id == NO_NODE || this->expr_types[id] != STATIC_TYPE::ARRAY){ return false; }
+    const EXPR& expr = exprs[id];
+    return expr.type == expression_type::BINARY || (expr.type == expression_type::UNARY && expr.op == OPERATOR_KIND::SUB);
+}
+
+static inline bool is_arithmetic(OPERATOR_KIND op){
+    return op == OPERATOR_KIND::ADD || op == OPERATOR_KIND::SUB || op == OPERATOR_KIND::MUL || op == OPERATOR_KIND::DIV;
+}
+
+STATIC_TYPE AST::infer_expr(EXPR_ID id){
+    if(id == NO_NODE){ return STATIC_TYPE::DYNAMIC; }
+    const EXPR& expr = exprs[id];
+    STATIC_TYPE type = STATIC_TYPE::DYNAMIC;
+
+    switch(expr.type){
+        case expression_type::LITERAL:
+            type = expr.literal_type == TOKEN_TYPE::NUMBER ? STATIC_TYPE::NUMBER : STATIC_TYPE::STRING;
+            break;
+
+        case expression_type::IDENTIFIER: {
+            const STMT_ID binding = this->visible_bindings[expr.name];
+            if(binding != NO_NODE){
+                type = this->binding_types[binding];
+            }
+            break;
+        }
+
+        case expression_type::UNARY: {
+            const STATIC_TYPE operand = this->infer_expr(expr.operand);
+            // unary '+' is a no-op, '-' keeps integers and numbers apart, '!' always gives a number
+            if(expr.op == OPERATOR_KIND::ADD){
+                type = operand;
+            }else if(expr.op == OPERATOR_KIND::SUB){
+                type = operand == STATIC_TYPE::INTEGER || operand == STATIC_TYPE::NUMBER || operand == STATIC_TYPE::ARRAY ? operand : STATIC_TYPE::DYNAMIC;
+            }else{
+                type = STATIC_TYPE::NUMBER;
+            }
+            break;
+        }
+
+        case expression_type::BINARY: {
+            const STATIC_TYPE left = this->infer_expr(expr.binary.left);
+            const STATIC_TYPE right = this->infer_expr(expr.binary.right);
+
+            // an array on either side makes the whole expression an array, scalars apply to every element
+            if(is_arithmetic(expr.op) && (left == STATIC_TYPE::ARRAY || right == STATIC_TYPE::ARRAY)){
+                type = STATIC_TYPE::ARRAY;
+                break;
+            }
+
+            switch(expr.op){
+                case OPERATOR_KIND::CONCAT:
+                    type = STATIC_TYPE::STRING;
+                    break;
+                case OPERATOR_KIND::ADD:
+                case OPERATOR_KIND::SUB:
+                case OPERATOR_KIND::MUL:
+                    // two integers stay one, a number on either side makes it a number
+                    if(this->integer_operands(expr.binary.left, expr.binary.right)){
+                        type = STATIC_TYPE::INTEGER;
+                    }else if(left == STATIC_TYPE::NUMBER || right == STATIC_TYPE::NUMBER){
+                        type = STATIC_TYPE::NUMBER;
+                    }
+                    break;
+                default:
+                    // division, comparisons and and/or produce a number or stop the program
+                    type = STATIC_TYPE::NUMBER;
+                    break;
+            }
+            break;
+        }
+
+        case expression_type::ARRAY_LITERAL: {
+            const NODE_RANGE elements = expr.array.elements;
+            for(uint32_t i = 0; i < elements.count; ++i){
+                this->infer_expr(expr_lists[elements.first + i]);
+            }
+            type = STATIC_TYPE::ARRAY;
+            break;
+        }
+
+        case expression_type::ARRAY_ACCESS:
+            this->infer_expr(expr.access.index); // elements aren't tracked
+            break;
+
+        case expression_type::ENUM_ACCESS:
+            type = STATIC_TYPE::ENUM;
+            break;
+
+        case expression_type::INTRINSIC: {
+            const NODE_RANGE args = expr.call.args;
+            for(uint32_t i = 0; i < args.count; ++i){
+                this->infer_expr(expr_lists[args.first + i]);
+            }
+            // DYNAMIC for results that follow the element types, which aren't tracked
+            type = intrinsic_info(expr.call.kind).result;
+            break;
+        }
+
+        case expression_type::ARRAY_EXTENTS: {
+            const NODE_RANGE extents = expr.allocation.extents;
+            for(uint32_t i = 0; i < extents.count; ++i){
+                this->infer_expr(expr_lists[extents.first + i]);
+            }
+            type = STATIC_TYPE::ARRAY;
+            break;
+        }
+
+        case expression_type::ARRAY_ACCESS_ND: {
+            const NODE_RANGE subscripts = expr.access_nd.subscripts;
+            for(uint32_t i = 0; i < subscripts.count; ++i){
+                this->infer_expr(expr_lists[subscripts.first + i]);
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    if(type == STATIC_TYPE::UNKNOWN){
+        type = STATIC_TYPE::DYNAMIC; // read before anything was stored, only on a pass that will repeat
+    }
+    this->expr_types[id] = type;
+    return type;
+}
+
+void AST::infer_block(NODE_RANGE block){
+    for(uint32_t i = 0; i < block.count; ++i){
+        this->infer_stmt(stmt_lists[block.first + i]);
+    }
+}
+
+void AST::infer_stmt(STMT_ID id){
+    const STMT& stmt = stmts[id];
+
+    switch(stmt.type){
+        case stmt_type::VAR_DECL: {
+            // the initializer is evaluated before the name is declared, as in codegen
+            const STATIC_TYPE init = this->infer_expr(stmt.var_decl.init);
+            this->visible_bindings[stmt.var_decl.name] = id;
+            if(!this->inference_scopes.empty()){
+                this->inference_scopes.back().push_back(stmt.var_decl.name);
+            }
+            this->infer_store(stmt.var_decl.name, init);
+            break;
+        }
+
+        case stmt_type::ENUM:
+            this->visible_bindings[stmt.enum_decl.name] = id;
+            if(!this->inference_scopes.empty()){
+                this->inference_scopes.back().push_back(stmt.enum_decl.name);
+            }
+            this->infer_store(stmt.enum_decl.name, STATIC_TYPE::DYNAMIC);
+            break;
+
+        case stmt_type::ASSIGNMENT: {
+            const STATIC_TYPE value = this->infer_expr(stmt.assignment.value);
+            if(stmt.assignment.target == NO_NODE){
+                this->infer_store(stmt.assignment.name, value);
+            }else{
+                this->infer_expr(stmt.assignment.target); // x[i] = ... leaves x itself alone
+            }
+            break;
+        }
+
+        case stmt_type::BLOCK:
+            this->infer_scope_start();
+            this->infer_block(stmt.block);
+            this->infer_scope_end();
+            break;
+
+        case stmt_type::WHILE:
+            this->infer_expr(stmt.loop.condition);
+            this->infer_scope_start();
+            this->infer_block(stmt.loop.body);
+            this->infer_scope_end();
+            break;
+
+        case stmt_type::IF:
+            this->infer_expr(stmt.branch.condition);
+            this->infer_scope_start();
+            this->infer_block(stmt.branch.then_block);
+            this->infer_scope_end();
+            this->infer_scope_start();
+            this->infer_block(stmt.branch.else_block);
+            this->infer_scope_end();
+            break;
+
+        case stmt_type::DO_LOOP:
+            this->infer_expr(stmt.counted.start);
+            this->infer_expr(stmt.counted.end);
+            this->infer_expr(stmt.counted.step);
+            // LOOP_START stops the program unless the counter starts out as a number, and turns it into one
+            this->infer_store(stmt.counted.counter, STATIC_TYPE::NUMBER);
+            this->infer_scope_start();
+            this->infer_block(stmt.counted.body);
+            this->infer_scope_end();
+            break;
+
+        default:
+            break;
+    }
+}
+
+void AST::codegen_string(const std::string& text){
+
+    // alloc new string in string pool
+    auto it = this->string_hasher.string_to_hash.find(text);
+    if(it == this->string_hasher.string_to_hash.end()){
+        if(this->string_hasher.string_to_hash.size() == UINT32_MAX){
+            throw_error("Too many strings in program!");
+        }
+        uint32_t string_hash_id = this->string_hasher.string_to_hash.size();
+        this->string_hasher.string_to_hash[text] = string_hash_id;
+        this->emit(BTOKEN_TYPE::LOADSTRING, string_hash_id);
+    }else{
+        this->emit(BTOKEN_TYPE::LOADSTRING, it->second);
+    }
+}
+
+// type-specialized instruction of an arithmetic or comparison operator, for two number operands
+static bool numeric_opcode(OPERATOR_KIND op, BTOKEN_TYPE& type){
+    switch(op){
+        case OPERATOR_KIND::ADD: type = BTOKEN_TYPE::ADD_NUM; break;
+        case OPERATOR_KIND::SUB: type = BTOKEN_TYPE::SUB_NUM; break;
+        case OPERATOR_KIND::MUL: type = BTOKEN_TYPE::MUL_NUM; break;
+        case OPERATOR_KIND::DIV: type = BTOKEN_TYPE::DIV_NUM; break;
+        case OPERATOR_KIND::EQ:  type = BTOKEN_TYPE::EQ_NUM; break;
+        case OPERATOR_KIND::NE:  type = BTOKEN_TYPE::NE_NUM; break;
+        case OPERATOR_KIND::LT:  type = BTOKEN_TYPE::LT_NUM; break;
+        case OPERATOR_KIND::LE:  type = BTOKEN_TYPE::LE_NUM; break;
+        case OPERATOR_KIND::GT:  type = BTOKEN_TYPE::GT_NUM; break;
+        case OPERATOR_KIND::GE:  type = BTOKEN_TYPE::GE_NUM; break;
+        default: return false;
+    }
+    return true;
+}
+
+// operand of an *_INT instruction, whole number literals are pushed as integers
+void AST::codegen_integer(EXPR_ID id){
+    if(is_integer_literal(exprs[id])){
+        const EXPR& literal = exprs[id];
+        this->emit_integer(BTOKEN_TYPE::PUSH_INT, literal.whole ? literal.integer : static_cast<int64_t>(literal.number));
+    }else{
+        this->codegen_expr(id);
+    }
+}
+
+// both operands of a binary operator. A whole number literal next to an operand whose type is only
+// known at run time is pushed as an integer as well, so binary_op gives the same result the *_INT
+// instruction would have if inference had typed that operand
+void AST::codegen_operands(EXPR_ID left, EXPR_ID right, bool integer){
+    if(integer || (is_integer_literal(exprs[left]) && this->expr_types[right] == STATIC_TYPE::DYNAMIC)){
+        this->codegen_integer(left);
+    }else{
+        this->codegen_expr(left);
+    }
+
+    if(integer || (is_integer_literal(exprs[right]) && this->expr_types[left] == STATIC_TYPE::DYNAMIC)){
+        this->codegen_integer(right);
+    }else{
+        this->codegen_expr(right);
+    }
+}
+
+// integer instruction of an arithmetic operator, the others run on integers through OP
+static bool integer_opcode(OPERATOR_KIND op, BTOKEN_TYPE& type){
+    switch(op){
+        case OPERATOR_KIND::ADD: type = BTOKEN_TYPE::ADD_INT; break;
+        case OPERATOR_KIND::SUB: type = BTOKEN_TYPE::SUB_INT; break;
+        case OPERATOR_KIND::MUL: type = BTOKEN_TYPE::MUL_INT; break;
+        default: return false;
+    }
+    return true;
+}
+
+// value about to be stored into a variable, returns the store to use:
+// integer variables need STORE_INT unless the value already is an integer
+BTOKEN_TYPE AST::codegen_stored_value(EXPR_ID value, bool integer, NAME_ID target){
+    if(!integer){
+        if(target != NO_NAME && this->is_array_op(value)){
+            this->codegen_array_op(value, this->array_handle(target)); // computed straight into the variable's array
+        }else if(target != NO_NAME && this->is_array_intrinsic(value)){
+            this->codegen_intrinsic(value, this->array_handle(target));
+        }else{
+            this->codegen_expr(value);
+        }
+        return BTOKEN_TYPE::STORE;
+    }
+    if(this->is_integer(value) || is_integer_literal(exprs[value])){
+        this->codegen_integer(value);
+        return BTOKEN_TYPE::STORE;
+    }
+    this->codegen_expr(value);
+    return BTOKEN_TYPE::STORE_INT;
+}
+
+// whole-array arithmetic, the operands are pushed as usual (arrays as ARRAY values, scalars as numbers)
+// and ARRAY_OP writes every element of the result into the array `destination`, then pushes that array
+void AST::codegen_array_op(EXPR_ID id, uint32_t destination){
+    const EXPR& expr = this->exprs[id];
+    unsigned char op;
+
+    if(expr.type == expression_type::UNARY){
+        // -a as a * -1, integer elements stay integers like they do with NEG
+        this->codegen_expr(expr.operand);
+        this->emit_integer(BTOKEN_TYPE::PUSH_INT, -1);
+        op = '*';
+    }else{
+        this->codegen_expr(expr.binary.left); // inner array expressions land in temporaries
+        this->codegen_expr(expr.binary.right);
+        op = operator_info(expr.op).code;
+    }
+
+    this->emit(BTOKEN_TYPE::ARRAY_OP, destination);
+    this->bytecode.back().op = op;
+}
+
+uint32_t AST::new_array_handle(){
+    if(this->array_count == UINT32_MAX - 1){
+        throw_error("Too many arrays declared in program!");
+    }
+    return this->array_count++;
+}
+
+// the array a variable owns, literals and whole-array results assigned to it are written there
+uint32_t AST::array_handle(NAME_ID name){
+    if(this->array_codification[name] == NO_SLOT){
+        this->array_codification[name] = this->new_array_handle();
+    }
+    return this->array_codification[name];
+}
+
+// temporaries are handed back at the start of every statement, a statement never reads one of another
+uint32_t AST::array_temporary(){
+    if(this->temporaries_in_use == this->array_temporaries.size()){
+        this->array_temporaries.push_back(this->new_array_handle());
+    }
+    return this->array_temporaries[this->temporaries_in_use++];
+}
+
+// value stored into an array element or literal element, an array result is copied out of its
+// temporary there, otherwise the element would change with the next statement using that temporary
+void AST::codegen_kept_value(EXPR_ID id){
+    this->codegen_expr(id);
+    if(this->is_array_op(id) || this->is_array_intrinsic(id)){
+        this->emit(BTOKEN_TYPE::ARRAY_COPY);
+    }
+}
+
+bool AST::is_array_intrinsic(EXPR_ID id) const {
+    return exprs[id].type == expression_type::INTRINSIC && intrinsic_info(exprs[id].call.kind).result == STATIC_TYPE::ARRAY;
+}
+
+// every argument is pushed, then one instruction turns them into the result, a reduction to a single
+// value or, for matmul and transpose, an array computed into `destination` (a temporary when NO_SLOT)
+void AST::codegen_intrinsic(EXPR_ID id, uint32_t destination){
+    const EXPR& expr = this->exprs[id];
+    const INTRINSIC_INFO& info = intrinsic_info(expr.call.kind);
+
+    for(uint32_t i = 0; i < expr.call.args.count; ++i){
+        const EXPR_ID arg = expr_lists[expr.call.args.first + i];
+        const STATIC_TYPE type = this->expr_types[arg];
+        if(type != STATIC_TYPE::ARRAY && type != STATIC_TYPE::DYNAMIC){
+            throw_error(std::string(info.spelling) + " expects array arguments");
+        }
+        this->codegen_expr(arg); // array expressions land in temporaries
+    }
+
+    if(info.result == STATIC_TYPE::ARRAY){
+        this->emit(info.opcode, destination == NO_SLOT ? this->array_temporary() : destination);
+    }else{
+        this->emit(info.opcode);
+        this->bytecode.back().op = info.code;
+    }
+}
+
+// pushes every subscript of m[i, j, k] in order, integers as they are
+uint32_t AST::codegen_subscripts(EXPR_ID id){
+    const EXPR& expr = this->exprs[id];
+    const NAME_ID array_name = expr.access_nd.array;
+
+    if(!this->is_declared(array_name) || this->array_codification[array_name] == NO_SLOT){
+        throw_error("Invalid array of name: " + names[array_name]);
+    }
+
+    const NODE_RANGE subscripts = expr.access_nd.subscripts;
+    for(uint32_t i = 0; i < subscripts.count; ++i){
+        this->codegen_integer(expr_lists[subscripts.first + i]);
+    }
+    return this->array_codification[array_name];
+}
+
+void AST::codegen_expr(EXPR_ID id){
+    if(id == NO_NODE){return;}
+    const EXPR& expr = this->exprs[id]; // codegen never allocates nodes
+
+    if(this->is_array_op(id)){
+        this->codegen_array_op(id, this->array_temporary()); // not assigned to a variable, e.g. x[i] = a + b
+        return;
+    }
+
+    switch (expr.type){
+        case expression_type::LITERAL:
+        {
+            if(expr.literal_type == TOKEN_TYPE::STRING){
+                this->codegen_string(names[expr.text]);
+            }else{
+                // simply push number
+                this->emit(BTOKEN_TYPE::PUSH, literal_number(expr));
+            }
+
+            break;
+        }
+
+        case expression_type::ENUM_ACCESS:{
+
+            const NAME_ID enum_name = expr.enum_access.enum_name;
+            const NAME_ID enum_value = expr.enum_access.value;
+
+            if(!this->is_declared(enum_name)){
+                throw_error("Invalid enum of name: " + names[enum_name]);
+            }
+
+            const std::vector<NAME_ID>& members = this->enum_value_to_enums[enum_name];
+            auto member = std::find(members.begin(), members.end(), enum_value);
+            if(member == members.end()){
+                throw_error("Enum object: " + names[enum_value] + " doesn't exist in: " + names[enum_name] + " enum");
+            }
+
+            uint16_t enum_index = std::distance(members.begin(), member);
+            // also have to add enum id from where it comes
+
+            this->emit(BTOKEN_TYPE::PUSH, this->enum_name_to_uint8[enum_name]);
+            this->emit(BTOKEN_TYPE::PUSH_ENUM_VALUE, enum_index);
+
+            break;
+        }
+
+        case expression_type::ARRAY_ACCESS:{
+
+            const NAME_ID array_name = expr.access.array;
+
+            if(!this->is_declared(array_name)) {
+                throw_error("Invalid variable of name: " + names[array_name]);
+                break;
+            }
+
+            if(this->array_codification[array_name] == NO_SLOT){
+                throw_error("Invalid array of name: " + names[array_name]);
+                break;
+            }
+
+            this->codegen_expr(expr.access.index);
+
+            this->emit(BTOKEN_TYPE::LOAD_ARRAY_AT, this->array_codification[array_name]); // loads array at top index
+
+            break;
+        }
+
+        case expression_type::ARRAY_LITERAL:{
+
+            const NODE_RANGE elements = expr.array.elements;
+            for(uint32_t i = 0; i < elements.count; ++i){ // write all array elements
+                this->codegen_kept_value(expr_lists[elements.first + i]);
+            }
+
+            const NAME_ID array_name = expr.array.array;
+
+            if(!this->is_declared(array_name) && (array_name == NO_NAME || !this->variables_in_declaration_proccess[array_name])){
+                throw_error("Invalid array variable of name: " + names[array_name]);
+            }
+
+            if(elements.count > UINT16_MAX){
+                throw_error("Too many elements in array literal: " + names[array_name]);
+            }
+
+            // the literal (re)fills the array with the elements pushed above
+            this->emit(BTOKEN_TYPE::LOAD_ARRAY, this->array_handle(array_name));
+            this->bytecode.back().slot = elements.count;
+
+            break;
+        }
+
+        case expression_type::UNARY:{
+
+            this->codegen_expr(expr.operand);
+
+            switch(expr.op){
+                case OPERATOR_KIND::ADD:
+                    break;
+                case OPERATOR_KIND::NOT:
+                    this->emit(BTOKEN_TYPE::NOT);
+                    break;
+                case OPERATOR_KIND::SUB:
+                    this->emit(BTOKEN_TYPE::NEG);
+                    break;
+                default:
+                    throw_error(std::string("Invalid unary op: '") + operator_info(expr.op).spelling + '\'');
+                    break;
+            }
+
+            break;
+        }
+
+        case expression_type::IDENTIFIER: {
+
+            if(!this->is_declared(expr.name)) {
+                throw_error("Invalid variable of name: " + names[expr.name]);
+                break;
+            }
+
+            uint16_t var_code = var_codification[expr.name];
+            this->emit(BTOKEN_TYPE::LOAD, var_code);
+            break;
+        }
+
+
+        case expression_type::INTRINSIC:
+            this->codegen_intrinsic(id);
+            break;
+
+        case expression_type::ARRAY_ACCESS_ND:{
+            const uint32_t handle = this->codegen_subscripts(id);
+            this->emit(BTOKEN_TYPE::LOAD_ARRAY_AT_ND, handle);
+            this->bytecode.back().slot = expr.access_nd.subscripts.count;
+            break;
+        }
+
+        case expression_type::ARRAY_EXTENTS:{
+            const NODE_RANGE extents = expr.allocation.extents;
+            for(uint32_t i = 0; i < extents.count; ++i){
+                this->codegen_expr(expr_lists[extents.first + i]);
+            }
+
+            // declared like a literal, the array belongs to the variable being declared
+            this->emit(BTOKEN_TYPE::ALLOCATE_ARRAY, this->array_handle(expr.allocation.array));
+            this->bytecode.back().slot = extents.count;
+            this->bytecode.back().aux = expr.allocation.integer;
+            break;
+        }
+
+        case expression_type::BINARY:{
+
+            if(expr.op == OPERATOR_KIND::CONCAT){
+                // normally folded already, both sides are string literals
+                this->codegen_string(names[exprs[expr.binary.left].text] + names[exprs[expr.binary.right].text]);
+                break;
+            }
+
+            const bool integer = expr.op != OPERATOR_KIND::AND && expr.op != OPERATOR_KIND::OR &&
+                                 this->integer_operands(expr.binary.left, expr.binary.right);
+            this->codegen_operands(expr.binary.left, expr.binary.right, integer);
+
+            // as a value both sides are evaluated, conditions short-circuit in codegen_branch instead
+            switch(expr.op){
+                case OPERATOR_KIND::AND:
+                    this->emit(BTOKEN_TYPE::AND);
+                    break;
+                case OPERATOR_KIND::OR:
+                    this->emit(BTOKEN_TYPE::OR);
+                    break;
+                case OPERATOR_KIND::ADD:
+                case OPERATOR_KIND::SUB:
+                case OPERATOR_KIND::MUL:
+                case OPERATOR_KIND::DIV:
+                case OPERATOR_KIND::EQ:
+                case OPERATOR_KIND::NE:
+                case OPERATOR_KIND::LT:
+                case OPERATOR_KIND::LE:
+                case OPERATOR_KIND::GT:
+                case OPERATOR_KIND::GE: {
+                    BTOKEN_TYPE typed;
+                    if(integer && integer_opcode(expr.op, typed)){
+                        this->emit(typed);
+                    }else if(this->is_number(expr.binary.left) && this->is_number(expr.binary.right) && numeric_opcode(expr.op, typed)){
+                        this->emit(typed);
+                    }else{
+                        this->emit_op(operator_info(expr.op).code);
+                    }
+                    break;
+                }
+                default:
+                    throw_error(std::string("Invalid binary op: '") + operator_info(expr.op).spelling + '\'');
+                    break;
+            }
+
+            break;
+        }
+
+        default:
+            throw_error("Invalid expression type detected!");
+            break;
+    }
+}
+
+// maps a comparison operator to the branch taken when it holds / when it doesn't
+static bool comparison_branch(OPERATOR_KIND op, STATIC_TYPE operands, BTOKEN_TYPE& when_true, BTOKEN_TYPE& when_false){
+    if(operands == STATIC_TYPE::INTEGER){
+        switch(op){
+            case OPERATOR_KIND::EQ: when_true = BTOKEN_TYPE::JUMP_IF_EQ_INT; when_false = BTOKEN_TYPE::JUMP_IF_NE_INT; break;
+            case OPERATOR_KIND::NE: when_true = BTOKEN_TYPE::JUMP_IF_NE_INT; when_false = BTOKEN_TYPE::JUMP_IF_EQ_INT; break;
+            case OPERATOR_KIND::LT: when_true = BTOKEN_TYPE::JUMP_IF_LT_INT; when_false = BTOKEN_TYPE::JUMP_IF_GE_INT; break;
+            case OPERATOR_KIND::GT: when_true = BTOKEN_TYPE::JUMP_IF_GT_INT; when_false = BTOKEN_TYPE::JUMP_IF_LE_INT; break;
+            case OPERATOR_KIND::LE: when_true = BTOKEN_TYPE::JUMP_IF_LE_INT; when_false = BTOKEN_TYPE::JUMP_IF_GT_INT; break;
+            case OPERATOR_KIND::GE: when_true = BTOKEN_TYPE::JUMP_IF_GE_INT; when_false = BTOKEN_TYPE::JUMP_IF_LT_INT; break;
+            default: return false;
+        }
+        return true;
+    }
+
+    if(operands == STATIC_TYPE::NUMBER){
+        switch(op){
+            case OPERATOR_KIND::EQ: when_true = BTOKEN_TYPE::JUMP_IF_EQ_NUM; when_false = BTOKEN_TYPE::JUMP_IF_NE_NUM; break;
+            case OPERATOR_KIND::NE: when_true = BTOKEN_TYPE::JUMP_IF_NE_NUM; when_false = BTOKEN_TYPE::JUMP_IF_EQ_NUM; break;
+            case OPERATOR_KIND::LT: when_true = BTOKEN_TYPE::JUMP_IF_LT_NUM; when_false = BTOKEN_TYPE::JUMP_IF_GE_NUM; break;
+            case OPERATOR_KIND::GT: when_true = BTOKEN_TYPE::JUMP_IF_GT_NUM; when_false = BTOKEN_TYPE::JUMP_IF_LE_NUM; break;
+            case OPERATOR_KIND::LE: when_true = BTOKEN_TYPE::JUMP_IF_LE_NUM; when_false = BTOKEN_TYPE::JUMP_IF_GT_NUM; break;
+            case OPERATOR_KIND::GE: when_true = BTOKEN_TYPE::JUMP_IF_GE_NUM; when_false = BTOKEN_TYPE::JUMP_IF_LT_NUM; break;
+            default: return false;
+        }
+        return true;
+    }
+
+    switch(op){
+        case OPERATOR_KIND::EQ: when_true = BTOKEN_TYPE::JUMP_IF_EQ; when_false = BTOKEN_TYPE::JUMP_IF_NE; break;
+        case OPERATOR_KIND::NE: when_true = BTOKEN_TYPE::JUMP_IF_NE; when_false = BTOKEN_TYPE::JUMP_IF_EQ; break;
+        case OPERATOR_KIND::LT: when_true = BTOKEN_TYPE::JUMP_IF_LT; when_false = BTOKEN_TYPE::JUMP_IF_GE; break;
+        case OPERATOR_KIND::GT: when_true = BTOKEN_TYPE::JUMP_IF_GT; when_false = BTOKEN_TYPE::JUMP_IF_LE; break;
+        case OPERATOR_KIND::LE: when_true = BTOKEN_TYPE::JUMP_IF_LE; when_false = BTOKEN_TYPE::JUMP_IF_GT; break;
+        case OPERATOR_KIND::GE: when_true = BTOKEN_TYPE::JUMP_IF_GE; when_false = BTOKEN_TYPE::JUMP_IF_LT; break;
+        default: return false;
+    }
+    return true;
+}
+
+uint32_t AST::new_label(){
+    uint32_t label_id = this->goto_hasher.label_to_address.size();
+    this->goto_hasher.add_label(0); // temp address, resolved from the LABEL instruction
+    return label_id;
+}
+
+// jumps to label_id when the condition's truth equals jump_when. comparisons become one compare-and-branch
+// instead of OP + GOTO_IF_FALSE, a leading '!' flips the branch instead of running NOT, and and/or
+// short-circuit: the right operand is only evaluated when the left one doesn't decide the result
+void AST::codegen_branch(EXPR_ID condition, bool jump_when, uint32_t label_id){
+    const EXPR& cond = exprs[condition];
+
+    if(cond.type == expression_type::UNARY && cond.op == OPERATOR_KIND::NOT){
+        this->codegen_branch(cond.operand, !jump_when, label_id);
+        return;
+    }
+
+    if(cond.type == expression_type::BINARY && (cond.op == OPERATOR_KIND::AND || cond.op == OPERATOR_KIND::OR)){
+        // 'and' decides on a false left operand, 'or' on a true one
+        const bool deciding_value = cond.op == OPERATOR_KIND::OR;
+
+        if(jump_when == deciding_value){
+            // the left operand alone can take the jump
+            this->codegen_branch(cond.binary.left, jump_when, label_id);
+            this->codegen_branch(cond.binary.right, jump_when, label_id);
+        }else{
+            // the left operand deciding means the jump is not taken, skip over the right one
+            const uint32_t skip_label_id = this->new_label();
+            this->codegen_branch(cond.binary.left, deciding_value, skip_label_id);
+            this->codegen_branch(cond.binary.right, jump_when, label_id);
+            this->emit(BTOKEN_TYPE::LABEL, skip_label_id);
+        }
+        return;
+    }
+
+    BTOKEN_TYPE when_true, when_false;
+    STATIC_TYPE operands = STATIC_TYPE::DYNAMIC;
+    if(cond.type == expression_type::BINARY){
+        if(this->integer_operands(cond.binary.left, cond.binary.right)){
+            operands = STATIC_TYPE::INTEGER;
+        }else if(this->is_number(cond.binary.left) && this->is_number(cond.binary.right)){
+            operands = STATIC_TYPE::NUMBER;
+        }
+    }
+
+    if(cond.type == expression_type::BINARY && comparison_branch(cond.op, operands, when_true, when_false)){
+        this->codegen_operands(cond.binary.left, cond.binary.right, operands == STATIC_TYPE::INTEGER);
+
+        BTOKEN jump(jump_when ? when_true : when_false, static_cast<double>(label_id));
+        jump.op = operator_info(cond.op).code;
+        this->bytecode.push_back(jump);
+        return;
+    }
+
+    this->codegen_expr(condition);
+    this->emit(jump_when ? BTOKEN_TYPE::GOTO_IF_TRUE : BTOKEN_TYPE::GOTO_IF_FALSE, label_id);
+}
+
+void AST::codegen_block(NODE_RANGE block){
+    for(uint32_t i = 0; i < block.count; ++i){
+        this->codegen(stmt_lists[block.first + i]);
+    }
+}
+
+void AST::codegen(STMT_ID id){
+
+    if(id == NO_NODE){ return; }
+    const STMT& stmt = this->stmts[id];
+    this->temporaries_in_use = 0;
+
+    switch(stmt.type){
+        case stmt_type::VAR_DECL:{
+
+            const NAME_ID var_name = stmt.var_decl.name;
+            if(this->is_declared(var_name)){
+                throw_error("Variable already declared: " + names[var_name]);
+            }
+
+            this->variables_in_declaration_proccess[var_name]=true;
+            this->integer_variables[var_name] = stmt.var_decl.integer;
+            const BTOKEN_TYPE store = this->codegen_stored_value(stmt.var_decl.init, stmt.var_decl.integer, var_name);
+            this->variables_in_declaration_proccess[var_name]=false;
+            uint16_t var_code = this->declare_variable(var_name);
+            this->emit(store, var_code);
+
+            break;
         }
 
         case stmt_type::ENUM: {
-            const std::string& enum_name = stmt->enum_name;
+            const NAME_ID enum_name = stmt.enum_decl.name;
 
-            if(var_codification.find(enum_name) != var_codification.end()){
-                throw_error("Enum already declared: " + enum_name);
+            if(this->is_declared(enum_name)){
+                throw_error("Enum already declared: " + names[enum_name]);
             }
 
-            uint16_t var_code = var_codification.size();
-            var_codification[enum_name] = var_code;
+            this->declare_variable(enum_name);
 
             this->variables_in_declaration_proccess[enum_name] = true;
 
             // assign a new enum ID
             int enum_id = this->enum_map.size()+1;
-            std::cout<<">>"<<enum_id<<"\n";
             this->enum_map[enum_id] = {};
             this->enum_name_to_uint8[enum_name] = enum_id;
 
             // now push enum values
-            auto& values = this->enum_map[enum_id];
-            for(int i = 0; i < stmt->enum_body->enum_elements.size(); ++i){
-                this->enum_value_to_enums[enum_name].push_back(stmt->enum_body->enum_elements[i]);
-                this->bytecode += "PUSH " + std::to_string(enum_id) + "\n";
-                this->bytecode += "STORE_ENUM_VALUE " + std::to_string(i) + "\n";
+            const NODE_RANGE members = exprs[stmt.enum_decl.body].members;
+            std::vector<NAME_ID>& values = this->enum_value_to_enums[enum_name];
+            for(uint32_t i = 0; i < members.count; ++i){
+                values.push_back(name_lists[members.first + i]);
+                this->emit(BTOKEN_TYPE::PUSH, enum_id);
+                this->emit(BTOKEN_TYPE::STORE_ENUM_VALUE, i);
                 this->enum_map[enum_id].push_back(i);
-             //   std::cout<<this->enum_map[enum_id].back()<<"!<>\n";
             }
 
-            this->variables_in_declaration_proccess.erase(enum_name);
+            this->variables_in_declaration_proccess[enum_name] = false;
 
             break;
         }
 
         case stmt_type::ASSIGNMENT:{
-            
-            if(!stmt->array_assign_expr){
 
-                const std::string& var_name = stmt->var_name;
+            if(stmt.assignment.target == NO_NODE){
+
+                const NAME_ID var_name = stmt.assignment.name;
 
-                if(this->var_codification.find(var_name) == this->var_codification.end()){
-                    throw_error("Variable of name: " + var_name + " hasn't been declared");
+                if(!this->is_declared(var_name)){
+                    throw_error("Variable of name: " + names[var_name] + " hasn't been declared");
                 }
 
                 uint16_t var_code = var_codification[var_name];
-                this->codegen_expr(stmt->assign_expr);
-                this->bytecode += "STORE " + std::to_string(var_code) + "\n";
+                const BTOKEN_TYPE store = this->codegen_stored_value(stmt.assignment.value, this->integer_variables[var_name], var_name);
+                this->emit(store, var_code);
+            }else if(exprs[stmt.assignment.target].type == expression_type::ARRAY_ACCESS_ND){
+
+                this->codegen_kept_value(stmt.assignment.value);
+                const uint32_t handle = this->codegen_subscripts(stmt.assignment.target);
+                this->emit(BTOKEN_TYPE::SET_ARRAY_AT_ND, handle);
+                this->bytecode.back().slot = exprs[stmt.assignment.target].access_nd.subscripts.count;
             }else{
 
-                const std::string& var_name = stmt->array_assign_expr->array_name;
+                const EXPR& target = exprs[stmt.assignment.target];
+                const NAME_ID var_name = target.access.array;
 
-                if(this->array_codification.find(var_name) == this->array_codification.end()){
-                    throw_error("Variable of name: " + var_name + " hasn't been declared");
+                if(this->array_codification[var_name] == NO_SLOT){
+                    throw_error("Variable of name: " + names[var_name] + " hasn't been declared");
                 }
-                
-                codegen_expr(stmt->assign_expr); 
-                codegen_expr(stmt->array_assign_expr->array_index); // push index
-                this->bytecode += "SET_ARRAY_AT " + std::to_string(this->array_codification[stmt->array_assign_expr->array_name]) + "\n";
+
+                this->codegen_kept_value(stmt.assignment.value);
+                codegen_expr(target.access.index); // push index
+                this->emit(BTOKEN_TYPE::SET_ARRAY_AT, this->array_codification[var_name]);
             }
 
             break;
         }
 
         case stmt_type::BLOCK:{
-            
-            this->parse_scope_start();
-            for(auto& Stmt : stmt->then_block){
-                codegen(Stmt);
-            }
-
-            if(this->scope_var_count.empty()){
-                throw_error("No open scope to end");
-            }
 
+            this->parse_scope_start();
+            this->codegen_block(stmt.block);
             this->parse_scope_end();
 
             break;
         }
 
         case stmt_type::LIST:{
-            
-            const std::string& var_name = stmt->list_var_name;
 
-            if(this->var_codification.find(var_name) == this->var_codification.end()){
-                throw_error("Invalid variable of name: " + var_name);
+            const NAME_ID var_name = stmt.list.name;
+
+            if(!this->is_declared(var_name)){
+                throw_error("Invalid variable of name: " + names[var_name]);
             }
 
-            this->bytecode+="LIST " + std::to_string(this->var_codification[var_name]) + "\n";
+            this->emit(BTOKEN_TYPE::LIST, this->var_codification[var_name]);
 
             break;
         }
 
         case stmt_type::WHILE:{
 
-            uint16_t start_label_id = this->goto_hasher.label_to_address.size();
-            this->goto_hasher.add_label(0); // temp address
-            uint16_t end_label_id = this->goto_hasher.label_to_address.size();
-            this->goto_hasher.add_label(0); // temp address
+            uint32_t start_label_id = this->new_label();
+            uint32_t end_label_id = this->new_label();
 
-            this->bytecode+="LABEL "+std::to_string(start_label_id)+"\n";
-            this->codegen_expr(stmt->condition);
-            this->bytecode+="GOTO_IF_FALSE " + std::to_string(end_label_id) + "\n";
+            this->emit(BTOKEN_TYPE::LABEL, start_label_id);
+            if(stmt.loop.condition != NO_NODE){ // folded away when it is constant true
+                this->codegen_branch(stmt.loop.condition, false, end_label_id);
+            }
 
             this->parse_scope_start();
+            this->codegen_block(stmt.loop.body);
+            this->parse_scope_end();
+
+            this->emit(BTOKEN_TYPE::GOTO, start_label_id);
+            this->emit(BTOKEN_TYPE::LABEL, end_label_id);
+
+            break;
+        }
+
+        case stmt_type::DO_LOOP:{
 
-            for(auto& Stmt : stmt->then_block) {
-                this->codegen(Stmt);
+            const NAME_ID counter = stmt.counted.counter;
+            if(!this->is_declared(counter)){
+                throw_error("Variable of name: " + names[counter] + " hasn't been declared");
+            }
+
+            const EXPR_ID step = stmt.counted.step;
+            if(step != NO_NODE && exprs[step].type == expression_type::LITERAL &&
+               exprs[step].literal_type == TOKEN_TYPE::NUMBER && literal_number(exprs[step]) == 0){
+                throw_error("'do' loop step can't be zero!");
+            }
+
+            const uint16_t counter_slot = this->var_codification[counter];
+            uint32_t body_label_id = this->new_label();
+            uint32_t end_label_id = this->new_label();
+
+            this->parse_scope_start(); // the cached bound and step live as long as the loop
+            const uint16_t bound_slot = this->reserve_slots(2);
+
+            // an integer counter counts in integers, start, end and step are converted like any store into it
+            const bool integer = this->integer_variables[counter];
+
+            // start, end and step are all evaluated before the counter is assigned
+            const BTOKEN_TYPE counter_store = this->codegen_stored_value(stmt.counted.start, integer);
+            this->emit(this->codegen_stored_value(stmt.counted.end, integer), bound_slot);
+            if(step != NO_NODE){
+                this->emit(this->codegen_stored_value(step, integer), bound_slot + 1);
+            }else{
+                if(integer){
+                    this->emit_integer(BTOKEN_TYPE::PUSH_INT, 1);
+                }else{
+                    this->emit(BTOKEN_TYPE::PUSH, 1);
+                }
+                this->emit(BTOKEN_TYPE::STORE, bound_slot + 1);
             }
+            this->emit(counter_store, counter_slot);
+
+            BTOKEN loop_start(integer ? BTOKEN_TYPE::LOOP_START_INT : BTOKEN_TYPE::LOOP_START, static_cast<double>(end_label_id));
+            loop_start.slot = counter_slot;
+            loop_start.aux = bound_slot;
+            this->bytecode.push_back(loop_start);
 
+            this->emit(BTOKEN_TYPE::LABEL, body_label_id);
+
+            this->parse_scope_start();
+            this->codegen_block(stmt.counted.body);
             this->parse_scope_end();
 
-            this->bytecode += "GOTO " + std::to_string(start_label_id) + "\n";
-            this->bytecode += "LABEL " + std::to_string(end_label_id) + "\n";
+            BTOKEN loop_back(integer ? BTOKEN_TYPE::LOOP_INC_BRANCH_INT : BTOKEN_TYPE::LOOP_INC_BRANCH, static_cast<double>(body_label_id));
+            loop_back.slot = counter_slot;
+            loop_back.aux = bound_slot;
+            this->bytecode.push_back(loop_back);
+
+            this->emit(BTOKEN_TYPE::LABEL, end_label_id);
+            this->parse_scope_end();
 
             break;
         }
 
         case stmt_type::IF:{
 
-            this->codegen_expr(stmt->condition);
-            
-            uint16_t end_label_id = this->goto_hasher.label_to_address.size();
-            this->goto_hasher.add_label(0); // temp address
-            
-            if(!stmt->has_else){
-                this->bytecode+="GOTO_IF_FALSE " + std::to_string(end_label_id) + "\n";
-
-                this->parse_scope_start();
+            uint32_t end_label_id = this->new_label();
 
-                for(auto& Stmt:stmt->then_block){
-                    codegen(Stmt);
-                } 
+            if(!stmt.has_else){
+                this->codegen_branch(stmt.branch.condition, false, end_label_id);
 
+                this->parse_scope_start();
+                this->codegen_block(stmt.branch.then_block);
                 this->parse_scope_end();
 
-                this->bytecode+="LABEL " + std::to_string(end_label_id) + "\n";
+                this->emit(BTOKEN_TYPE::LABEL, end_label_id);
             }else{
 
-                uint16_t else_label_id = this->goto_hasher.label_to_address.size();
-                this->goto_hasher.add_label(0); // placeholder
+                uint32_t else_label_id = this->new_label();
 
-                this->bytecode += "GOTO_IF_FALSE " + std::to_string(else_label_id) + "\n";
+                this->codegen_branch(stmt.branch.condition, false, else_label_id);
 
                 this->parse_scope_start();
-                for (auto& s : stmt->then_block) {
-                    codegen(s);
-                }
+                this->codegen_block(stmt.branch.then_block);
                 this->parse_scope_end();
 
-                this->bytecode += "GOTO " + std::to_string(end_label_id) + "\n";
-                this->bytecode += "LABEL " + std::to_string(else_label_id) + "\n";
+                this->emit(BTOKEN_TYPE::GOTO, end_label_id);
+                this->emit(BTOKEN_TYPE::LABEL, else_label_id);
 
                 // --- ELSE BLOCK ---
                 this->parse_scope_start();
-                for (auto& s : stmt->else_block) {
-                    codegen(s);
-                }
+                this->codegen_block(stmt.branch.else_block);
                 this->parse_scope_end();
 
                 // End label
-                this->bytecode += "LABEL " + std::to_string(end_label_id) + "\n";
+                this->emit(BTOKEN_TYPE::LABEL, end_label_id);
             }
 
             break;
         }
-    }    
+    }
 }
 
 void AST::init_codegen(){
-    for(auto &stmt:this->statements){
-        this->codegen(stmt);
-    }
+    // folding is done, the name table won't grow anymore
+    this->var_codification.assign(this->names.size(), NO_SLOT);
+    this->array_codification.assign(this->names.size(), NO_SLOT);
+    this->integer_variables.assign(this->names.size(), false);
+    this->variables_in_declaration_proccess.assign(this->names.size(), false);
+
+    this->codegen_block(this->statements);
+}
+
+void AST::emit(BTOKEN_TYPE type, double operand){
+    this->bytecode.push_back({type, operand});
+}
+
+void AST::emit_integer(BTOKEN_TYPE type, int64_t operand){
+    this->bytecode.push_back(BTOKEN::integer(type, operand));
+}
+
+void AST::emit_op(unsigned char op){
+    this->bytecode.push_back({BTOKEN_TYPE::OP, op});
 }
 
 void AST::list_bytecode(){
-    std::cout<<this->bytecode;
+    for(const auto& btoken : this->bytecode){
+        std::cout << btoken_to_string(btoken) << "\n";
+    }
 }
 
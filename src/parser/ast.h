@@ -2,16 +2,56 @@
 #include "../error/error.h"
 #include "../runtime/memory/hasher.h"
 #include <unordered_map>
-#include <stack>
 #include <sstream>
 #include <cstdint>
 #include <memory>
 #include <functional>
 #include <climits>
+#include <cstdio>
+#include <string_view>
 
 #ifndef AST_H
 #define AST_H
 
+// Nodes live in arenas owned by AST (vectors that are only ever appended to) and refer to each
+// other by 32-bit index. Identifiers and string literals are interned once in a NAME_TABLE.
+
+using EXPR_ID = uint32_t;
+using STMT_ID = uint32_t;
+using NAME_ID = uint32_t;
+
+constexpr uint32_t NO_NODE = UINT32_MAX;
+constexpr uint32_t NO_NAME = UINT32_MAX;
+
+// -------------------- Names --------------------
+
+struct NAME_TABLE {
+    std::unordered_map<std::string, NAME_ID> ids;
+    std::vector<const std::string*> names; // NAME_ID -> text, map nodes never move
+
+    NAME_ID intern(std::string_view text){
+        // heterogeneous find() on unordered_map is C++20, build the key once and use it for both
+        auto [pos, inserted] = ids.try_emplace(std::string(text), static_cast<NAME_ID>(names.size()));
+        if(inserted){
+            names.push_back(&pos->first);
+        }
+        return pos->second;
+    }
+
+    const std::string& operator[](NAME_ID id) const {
+        static const std::string none;
+        return id == NO_NAME ? none : *names[id];
+    }
+
+    size_t size() const { return names.size(); }
+};
+
+// contiguous run of ids in one of the AST list arenas
+struct NODE_RANGE {
+    uint32_t first;
+    uint32_t count;
+};
+
 // -------------------- Expression --------------------
 enum class expression_type : uint8_t {
     LITERAL,    // number or string literal
@@ -22,32 +62,45 @@ enum class expression_type : uint8_t {
     ARRAY_ACCESS,
     ENUM_LITERAL,
     ENUM_ACCESS,
+    INTRINSIC,  // call of a built-in function, sum(a)
+    ARRAY_EXTENTS,   // zero-filled array of var m(3, 4), only as the init of a VAR_DECL
+    ARRAY_ACCESS_ND, // m[i, j] / m[i, j, k]
+};
+
+// built-in functions, see intrinsic_table in ast.cpp
+enum class INTRINSIC_KIND : uint8_t {
+    SUM,
+    PRODUCT,
+    MINVAL,
+    MAXVAL,
+    COUNT,
+    DOT_PRODUCT,
+    MATMUL,
+    TRANSPOSE,
 };
 
 struct EXPR {
 
     expression_type type;
+    TOKEN_TYPE literal_type; // NUMBER or STRING for literals
+    OPERATOR_KIND op;        // UNARY / BINARY
+    bool whole;              // NUMBER literal written without a '.' that fits int64, its value is in integer
 
-    TOKEN_TYPE literal_type; 
-    std::string value;              // literal value
-    std::string name;               // identifier name
-
-    std::string unary_op;           
-    std::shared_ptr<EXPR> unary_expr;
-
-    std::string binary_op;
-    std::shared_ptr<EXPR> left;
-    std::shared_ptr<EXPR> right;
-
-    // --- ENUM SUPPORT --- 
-    std::vector<std::string>enum_elements;
-    std::string enum_name;
-    std::string enum_value;
-
-    // --- ARRAY SUPPORT ---
-    std::vector<std::shared_ptr<EXPR>> array_elements; // for [a, b, c]
-    std::shared_ptr<EXPR> array_index;                 // for arr[i]
-    std::string array_name;                         // variable holding the array
+    union {
+        double number;                                          // LITERAL, number
+        int64_t integer;                                        // LITERAL, whole number
+        NAME_ID text;                                           // LITERAL, string
+        NAME_ID name;                                           // IDENTIFIER
+        EXPR_ID operand;                                        // UNARY
+        struct { EXPR_ID left, right; } binary;                 // BINARY
+        struct { NODE_RANGE elements; NAME_ID array; } array;   // ARRAY_LITERAL, elements in expr_lists, array = assignee
+        struct { NAME_ID array; EXPR_ID index; } access;        // ARRAY_ACCESS
+        struct { NAME_ID enum_name, value; } enum_access;       // ENUM_ACCESS
+        NODE_RANGE members;                                     // ENUM_LITERAL, names in name_lists
+        struct { NODE_RANGE args; INTRINSIC_KIND kind; } call;  // INTRINSIC, arguments in expr_lists
+        struct { NODE_RANGE extents; NAME_ID array; bool integer; } allocation; // ARRAY_EXTENTS, integer elements for `integer m(...)`
+        struct { NODE_RANGE subscripts; NAME_ID array; } access_nd;            // ARRAY_ACCESS_ND, subscripts in expr_lists
+    };
 };
 
 // -------------------- Statements --------------------
@@ -59,115 +112,207 @@ enum class stmt_type : uint8_t {
     WHILE,      // while loop
     BLOCK,       // scope block
     ENUM,
+    DO_LOOP,    // counted loop, do i = start, end, step ... end do
 };
 
 struct STMT {
     stmt_type type;
+    bool has_else;
 
-    std::string var_name;                 // var decl or assignment
-    std::shared_ptr<EXPR>array_assign_expr; // array assignment expression x[expr]
-    std::shared_ptr<EXPR> init_expr;      // var initializer
-    std::shared_ptr<EXPR> assign_expr;    // assignment expression
-    std::string list_var_name;            // list statement variable
-
-    std::shared_ptr<EXPR> condition;      // if or while condition
-    std::vector<std::shared_ptr<STMT>> then_block; // if/while/block body
-    std::vector<std::shared_ptr<STMT>> else_block; // optional else
-    std::string enum_name ; // enum decl
-    std::shared_ptr<EXPR> enum_body;
+    union {
+        struct { NAME_ID name; EXPR_ID init; bool integer; } var_decl; // integer for `integer x = ...`, `integer m(3)` marks its ARRAY_EXTENTS instead
+        struct { NAME_ID name; EXPR_ID value; EXPR_ID target; } assignment; // target is the ARRAY_ACCESS(_ND) of x[i] = ..., else NO_NODE
+        struct { NAME_ID name; } list;
+        struct { EXPR_ID condition; NODE_RANGE then_block, else_block; } branch; // IF
+        struct { EXPR_ID condition; NODE_RANGE body; } loop; // WHILE, condition is NO_NODE once folded to constant true
+        NODE_RANGE block;                                     // BLOCK, statements in stmt_lists
+        struct { NAME_ID name; EXPR_ID body; } enum_decl;     // ENUM, body is an ENUM_LITERAL
+        struct { NAME_ID counter; EXPR_ID start, end, step; NODE_RANGE body; } counted; // DO_LOOP, step is NO_NODE for 1
+    };
+};
 
-    bool has_else=false;
+// -------------------- Static Types --------------------
+// what infer_types() could prove about a value, DYNAMIC when it may hold more than one type
+enum class STATIC_TYPE : uint8_t {
+    UNKNOWN,    // nothing stored yet, identity of the join
+    NUMBER,     // a double, never an integer
+    INTEGER,
+    STRING,
+    ARRAY,
+    ENUM,
+    DYNAMIC,
 };
 
+inline STATIC_TYPE join_types(STATIC_TYPE a, STATIC_TYPE b){
+    if(a == STATIC_TYPE::UNKNOWN){ return b; }
+    if(b == STATIC_TYPE::UNKNOWN || a == b){ return a; }
+    return STATIC_TYPE::DYNAMIC;
+}
+
 struct AST {
-    
+
     std::string program_name;
-    std::vector<std::shared_ptr<STMT>> statements; // top-level statements
-    
+    NODE_RANGE statements{0, 0}; // top-level statements
+
+    // arenas
+    std::vector<EXPR> exprs;
+    std::vector<STMT> stmts;
+    std::vector<EXPR_ID> expr_lists;
+    std::vector<STMT_ID> stmt_lists;
+    std::vector<NAME_ID> name_lists;
+    NAME_TABLE names;
+
     STRING_HASHER string_hasher;
     GOTO_HASHER goto_hasher;
-   
+
     std::vector<TOKEN>tokens;
-    std::string bytecode="";
+    std::vector<BTOKEN>bytecode;
     std::string prog_name="";
-    std::stack<short int>scope_var_count;
-    std::unordered_map<std::string,unsigned short int>var_codification;
-    std::unordered_map<std::string,uint8_t>array_codification;
-    std::unordered_map<std::string,bool>variables_in_declaration_proccess;  /* 
+
+    struct SCOPE {
+        uint16_t first_slot;            // slot allocator position when the scope opened
+        std::vector<NAME_ID> names;     // variables declared in this scope
+    };
+    std::vector<SCOPE> scopes; // open scopes, innermost last
+    uint32_t next_slot = 0;    // slots are handed out stack-wise, a closed scope gives its slots back
+
+    // indexed by NAME_ID, sized once parsing and folding stopped adding names
+    static constexpr uint32_t NO_SLOT = UINT32_MAX;
+    std::vector<uint32_t> var_codification;   // variable slot or NO_SLOT
+    std::vector<uint32_t> array_codification; // runtime array handle or NO_SLOT
+    std::vector<bool> integer_variables; // declared with `integer`, stores go through STORE_INT
+    std::vector<bool> variables_in_declaration_proccess;  /*
     the reason why we do this is simple, array evaluation needs direct variable name but we don't register the var name
     before we parse the expression, which leads to an error, therefore we pre register it and than we erase it
     */
-          
+    uint32_t array_count = 0;
+    std::vector<uint32_t> array_temporaries; // hidden arrays holding the inner results of whole-array expressions
+    uint32_t temporaries_in_use = 0;         // of array_temporaries in the current statement
+
+    // type inference, see infer_types()
+    std::vector<STATIC_TYPE> expr_types;     // EXPR_ID -> type the expression evaluates to
+    std::vector<STATIC_TYPE> binding_types;  // declaring STMT_ID -> join of every value stored in the variable
+    std::vector<STMT_ID> visible_bindings;   // NAME_ID -> declaration in scope while inferring, NO_NODE if none
+    std::vector<std::vector<NAME_ID>> inference_scopes;
+    bool types_changed = false;
+
     std::unordered_map<int,std::vector<int>>enum_map; // enum idx=> enum values
-    std::unordered_map<std::string,std::vector<std::string>>enum_value_to_enums; // enum holder -> enum clasifications
-    std::unordered_map<std::string,uint8_t>enum_name_to_uint8;
+    std::unordered_map<NAME_ID,std::vector<NAME_ID>>enum_value_to_enums; // enum holder -> enum clasifications
+    std::unordered_map<NAME_ID,uint8_t>enum_name_to_uint8;
  //   VALUE em[MAX_ENUM][MAX_ENUM];
-    int idx=0;
+    size_t idx=0;
 
     public:
-        void init(const std::vector<TOKEN>& tokens){
-            this->tokens = tokens;
+        void init(std::vector<TOKEN>&& tokens){
+            this->tokens = std::move(tokens);
             this->parse();
+            this->tokens = {}; // nodes keep no token references, free them before codegen
             this->check_array_rules();
-            this->list();
+            this->fold_constants();
+            this->infer_types();
             this->init_codegen();
-            this->list_bytecode();
             string_hasher.fill_hashed_strings();
-            
+
             // string_hasher.fill_hashed_strings();
             // string_hasher.list();
         }
 
+        void list();
+        void list_bytecode();
+
     private:
         void parse();
-        
+
        // void init_external_mem_objects();
-        void list();
-        void list_stmt(const std::shared_ptr<STMT>& stmt, int indent);
-        void list_expr(const std::shared_ptr<EXPR>& expr, int indent);
+        void list_stmt(STMT_ID stmt, int indent);
+        void list_expr(EXPR_ID expr, int indent);
+
+        // -------------------- Arena Helpers --------------------
+        EXPR_ID new_expr(expression_type type);
+        STMT_ID new_stmt(stmt_type type);
+        NODE_RANGE push_list(std::vector<uint32_t>& list, const std::vector<uint32_t>& items);
+        bool is_declared(NAME_ID name) const;
 
         // -------------------- Expression Parsing --------------------
-        std::shared_ptr<EXPR> parse_expression();
-        std::shared_ptr<EXPR> parse_array_literal();
-        std::shared_ptr<EXPR> parse_enum_body();
-        std::shared_ptr<EXPR> parse_array_access(std::shared_ptr<EXPR>node);
-        std::shared_ptr<EXPR> parse_or();
-        std::shared_ptr<EXPR> parse_and();
-        std::shared_ptr<EXPR> parse_comparision();
-        std::shared_ptr<EXPR> parse_additive();
-        std::shared_ptr<EXPR> parse_term();
-        std::shared_ptr<EXPR> parse_unary();
-        std::shared_ptr<EXPR> parse_factor();
+        EXPR_ID parse_expression();
+        EXPR_ID parse_array_literal();
+        EXPR_ID parse_enum_body();
+        EXPR_ID parse_array_access(EXPR_ID node);
+        EXPR_ID parse_array_extents(NAME_ID array, bool integer);
+        EXPR_ID parse_binary(int min_precedence);
+        EXPR_ID parse_unary();
+        EXPR_ID parse_factor();
+        EXPR_ID parse_intrinsic(std::string_view name);
+        EXPR_ID make_binary(OPERATOR_KIND op, EXPR_ID left, EXPR_ID right);
 
         // -------------------- Statement Parsing --------------------
-        std::shared_ptr<STMT> parse_statement();
-        std::shared_ptr<STMT> parse_var();
-        std::shared_ptr<STMT> parse_assignment();
-        std::shared_ptr<STMT> parse_if();
-        std::shared_ptr<STMT> parse_while();
-        std::shared_ptr<STMT> parse_enum();
-        std::vector<std::shared_ptr<STMT>> parse_block();
-        std::shared_ptr<STMT>parse_list();
-        std::shared_ptr<STMT>parse_block_stmt();
+        STMT_ID parse_statement();
+        STMT_ID parse_var();
+        STMT_ID parse_if();
+        STMT_ID parse_while();
+        STMT_ID parse_do();
+        STMT_ID parse_do_loop();
+        STMT_ID parse_enum();
+        NODE_RANGE parse_block();
+        STMT_ID parse_list();
+        STMT_ID parse_block_stmt();
 
         // -------------------- Post Parsing ---------------------
 
         void check_array_rules();
-        void check_stmt_array_rules(const std::shared_ptr<STMT>& stmt, bool in_assignment_or_var, const std::string& current_var);
-        void check_expr_array_rules(const std::shared_ptr<EXPR>& expr, bool in_assignment_or_var, const std::string& current_var);
+        void check_stmt_array_rules(STMT_ID stmt);
+        void check_block_array_rules(NODE_RANGE block);
+        void check_expr_array_rules(EXPR_ID expr, bool in_assignment_or_var, NAME_ID current_var);
+
+        void fold_constants();
+        void fold_stmt(STMT_ID stmt);
+        void fold_block(NODE_RANGE block);
+        void fold_expr(EXPR_ID expr);
+        bool constant_truth(EXPR_ID expr, bool& truth) const;
+
+        void infer_types();
+        void infer_block(NODE_RANGE block);
+        void infer_stmt(STMT_ID stmt);
+        STATIC_TYPE infer_expr(EXPR_ID expr);
+        void infer_store(NAME_ID name, STATIC_TYPE type);
+        void infer_scope_start();
+        void infer_scope_end();
+        bool is_number(EXPR_ID expr) const;
+        bool is_integer(EXPR_ID expr) const;
+        bool integer_operands(EXPR_ID left, EXPR_ID right) const;
+        bool is_array_op(EXPR_ID expr) const;
 
 
         // -------------------- Scope Helpers --------------------
-        
+
         void parse_scope_start();
         void parse_scope_end();
+        uint16_t declare_variable(NAME_ID name);
+        uint16_t reserve_slots(uint32_t count);
 
-        // CODEGEN 
+        // CODEGEN
 
         void init_codegen(); // code generation start point
-        void codegen(std::shared_ptr<STMT>&stmt); // generate bytecode and implement all optimizatiosns over here.
-        void codegen_expr( std::shared_ptr<EXPR>&expr); // generate bytecode and implement all optimizatiosns over here.
-        void list_bytecode();
+        void codegen(STMT_ID stmt); // generate bytecode and implement all optimizatiosns over here.
+        void codegen_block(NODE_RANGE block);
+        void codegen_expr(EXPR_ID expr); // generate bytecode and implement all optimizatiosns over here.
+        void codegen_branch(EXPR_ID condition, bool jump_when, uint32_t label_id); // conditions of if / while, short-circuits and/or
+        uint32_t new_label();
+        void codegen_string(const std::string& text);
+        void codegen_integer(EXPR_ID expr);
+        BTOKEN_TYPE codegen_stored_value(EXPR_ID value, bool integer, NAME_ID target = NO_NAME);
+        void codegen_array_op(EXPR_ID expr, uint32_t destination);
+        void codegen_intrinsic(EXPR_ID expr, uint32_t destination = NO_SLOT); // destination of array results
+        bool is_array_intrinsic(EXPR_ID expr) const;
+        uint32_t codegen_subscripts(EXPR_ID expr); // ARRAY_ACCESS_ND, returns the array handle
+        uint32_t new_array_handle();
+        uint32_t array_handle(NAME_ID name);
+        uint32_t array_temporary();
+        void codegen_kept_value(EXPR_ID id);
+        void codegen_operands(EXPR_ID left, EXPR_ID right, bool integer);
+        void emit(BTOKEN_TYPE type, double operand = 0);
+        void emit_integer(BTOKEN_TYPE type, int64_t operand);
+        void emit_op(unsigned char op);
 };
 
-#endif 
+#endif
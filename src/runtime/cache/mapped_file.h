@@ -0,0 +1,97 @@
+// Read-only view of a whole file, mmapped where the platform allows it
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstddef>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+struct MAPPED_FILE{
+    const char* data = nullptr;
+    size_t size = 0;
+
+    MAPPED_FILE() = default;
+    MAPPED_FILE(const MAPPED_FILE&) = delete;
+    MAPPED_FILE& operator=(const MAPPED_FILE&) = delete;
+
+    ~MAPPED_FILE(){
+        close();
+    }
+
+    bool open(const std::string& path){
+        close();
+
+#ifndef _WIN32
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0){
+            return false;
+        }
+
+        struct stat st;
+        if(fstat(fd, &st) != 0){
+            ::close(fd);
+            return false;
+        }
+
+        size = static_cast<size_t>(st.st_size);
+        if(size == 0){
+            ::close(fd);
+            data = "";
+            return true;
+        }
+
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd); // the mapping keeps the file alive
+
+        if(mapping == MAP_FAILED){
+            size = 0;
+            return false;
+        }
+
+        data = static_cast<const char*>(mapping);
+        mapped = true;
+        return true;
+#else
+        // no mmap here, read the whole file in one call instead
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if(!file.is_open()){
+            return false;
+        }
+
+        fallback.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(fallback.data(), fallback.size());
+
+        data = fallback.data();
+        size = fallback.size();
+        return true;
+#endif
+    }
+
+    void close(){
+#ifndef _WIN32
+        if(mapped){
+            munmap(const_cast<char*>(data), size);
+        }
+#endif
+        fallback.clear();
+        mapped = false;
+        data = nullptr;
+        size = 0;
+    }
+
+    private:
+        bool mapped = false;
+        std::vector<char> fallback;
+};
+
+#endif
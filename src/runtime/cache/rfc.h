@@ -0,0 +1,268 @@
+// Precompiled program cache (.rfc)
+// holds everything the runtime needs after codegen so a cached script skips lexing, parsing and codegen entirely
+
+#ifndef RFC_H
+#define RFC_H
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <unordered_map>
+#include <type_traits>
+#include <random>
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+#include "mapped_file.h"
+#include "../memory/hasher.h"
+#include "../../lexer/lexer.h"
+
+// bump whenever BTOKEN_TYPE, BTOKEN or the codegen output changes shape
+#define RFC_VERSION 14
+
+static_assert(std::is_trivially_copyable<BTOKEN>::value, "BTOKEN is stored raw inside .rfc files");
+
+struct RFC_HEADER{
+    char magic[4];
+    uint32_t version;
+    uint64_t source_hash;
+    uint32_t btoken_size;
+    uint32_t bytecode_count;
+    uint32_t label_count;
+    uint32_t string_count;
+    uint32_t enum_count;
+    uint32_t reserved;
+};
+
+#ifdef _WIN32
+inline unsigned long current_process_id(){ return static_cast<unsigned long>(_getpid()); }
+#else
+inline unsigned long current_process_id(){ return static_cast<unsigned long>(getpid()); }
+#endif
+
+// FNV-1a over the raw source bytes
+inline uint64_t hash_source(const char* data, size_t size){
+    uint64_t hash = 14695981039346656037ull;
+    for(size_t i = 0; i < size; i++){
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+struct RFC_CACHE{
+
+    static std::string path_for(const std::string& source_path){
+        return source_path + "c"; // main.rf -> main.rfc
+    }
+
+    // instructions whose operand is a label id, the cached bytecode still carries its labels
+    static bool refers_to_label(BTOKEN_TYPE type){
+        switch(type){
+            case BTOKEN_TYPE::LABEL:
+            case BTOKEN_TYPE::GOTO:
+            case BTOKEN_TYPE::GOTO_IF_FALSE:
+            case BTOKEN_TYPE::GOTO_IF_TRUE:
+            case BTOKEN_TYPE::JUMP_IF_EQ:
+            case BTOKEN_TYPE::JUMP_IF_NE:
+            case BTOKEN_TYPE::JUMP_IF_LT:
+            case BTOKEN_TYPE::JUMP_IF_GT:
+            case BTOKEN_TYPE::JUMP_IF_LE:
+            case BTOKEN_TYPE::JUMP_IF_GE:
+            case BTOKEN_TYPE::LOOP_START:
+            case BTOKEN_TYPE::LOOP_INC_BRANCH:
+            case BTOKEN_TYPE::LOOP_START_INT:
+            case BTOKEN_TYPE::LOOP_INC_BRANCH_INT:
+            case BTOKEN_TYPE::JUMP_IF_EQ_INT:
+            case BTOKEN_TYPE::JUMP_IF_NE_INT:
+            case BTOKEN_TYPE::JUMP_IF_LT_INT:
+            case BTOKEN_TYPE::JUMP_IF_GT_INT:
+            case BTOKEN_TYPE::JUMP_IF_LE_INT:
+            case BTOKEN_TYPE::JUMP_IF_GE_INT:
+            case BTOKEN_TYPE::JUMP_IF_EQ_NUM:
+            case BTOKEN_TYPE::JUMP_IF_NE_NUM:
+            case BTOKEN_TYPE::JUMP_IF_LT_NUM:
+            case BTOKEN_TYPE::JUMP_IF_GT_NUM:
+            case BTOKEN_TYPE::JUMP_IF_LE_NUM:
+            case BTOKEN_TYPE::JUMP_IF_GE_NUM:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // returns false when there is no cache or it is stale / from another build, the caller then compiles from source
+    static bool load(const std::string& cache_path, uint64_t source_hash,
+                     std::vector<BTOKEN>& bytecode,
+                     STRING_HASHER& string_hasher,
+                     GOTO_HASHER& goto_hasher,
+                     std::unordered_map<int, std::vector<int>>& enum_map){
+
+        MAPPED_FILE file;
+        if(!file.open(cache_path) || file.size < sizeof(RFC_HEADER)){
+            return false;
+        }
+
+        RFC_HEADER header;
+        std::memcpy(&header, file.data, sizeof(header));
+
+        if(std::memcmp(header.magic, "RFC", 4) != 0 || header.version != RFC_VERSION ||
+           header.source_hash != source_hash || header.btoken_size != sizeof(BTOKEN)){
+            return false;
+        }
+
+        size_t pos = sizeof(RFC_HEADER);
+        auto in_bounds = [&](size_t bytes){ return pos + bytes <= file.size; };
+        auto read_u32 = [&](uint32_t& out){
+            if(!in_bounds(sizeof(out))) return false;
+            std::memcpy(&out, file.data + pos, sizeof(out));
+            pos += sizeof(out);
+            return true;
+        };
+
+        // bytecode, stored raw right after the header (header size keeps it 8 byte aligned)
+        const size_t bytecode_bytes = static_cast<size_t>(header.bytecode_count) * sizeof(BTOKEN);
+        if(!in_bounds(bytecode_bytes)){
+            return false;
+        }
+        const BTOKEN* tokens = reinterpret_cast<const BTOKEN*>(file.data + pos);
+        bytecode.assign(tokens, tokens + header.bytecode_count);
+        pos += bytecode_bytes;
+
+        // a matching hash doesn't make a damaged file safe, reject opcodes and label ids that codegen
+        // could not have written instead of running them
+        for(const BTOKEN& token : bytecode){
+            if(static_cast<size_t>(token.token_type) >= BTOKEN_TYPE_COUNT){
+                return false;
+            }
+            const double label_id = token.data.number_value;
+            if(refers_to_label(token.token_type) && !(label_id >= 0 && label_id < header.label_count)){
+                return false;
+            }
+        }
+
+        // resolved label table
+        goto_hasher.label_to_address.clear();
+        for(uint32_t i = 0; i < header.label_count; i++){
+            uint32_t address;
+            if(!read_u32(address)) return false;
+            goto_hasher.label_to_address[i] = address;
+        }
+
+        // string pool
+        string_hasher.hashed_strings.clear();
+        string_hasher.hashed_strings.reserve(header.string_count);
+        for(uint32_t i = 0; i < header.string_count; i++){
+            uint32_t length;
+            if(!read_u32(length) || !in_bounds(length)) return false;
+            string_hasher.hashed_strings.emplace_back(file.data + pos, length);
+            pos += length;
+        }
+
+        // enums, type id -> value ids
+        enum_map.clear();
+        for(uint32_t i = 0; i < header.enum_count; i++){
+            uint32_t type_id, value_count;
+            if(!read_u32(type_id) || !read_u32(value_count)) return false;
+
+            auto& values = enum_map[static_cast<int>(type_id)];
+            values.resize(value_count);
+            for(uint32_t j = 0; j < value_count; j++){
+                uint32_t value;
+                if(!read_u32(value)) return false;
+                values[j] = static_cast<int>(value);
+            }
+        }
+
+        return pos == file.size;
+    }
+
+    // a failed write only costs the next run a recompile, so errors are ignored
+    static void save(const std::string& cache_path, uint64_t source_hash,
+                     const std::vector<BTOKEN>& bytecode,
+                     const STRING_HASHER& string_hasher,
+                     const std::unordered_map<int, std::vector<int>>& enum_map){
+
+        // resolve label addresses the same way COMPILER::init_content does
+        std::vector<uint32_t> label_addresses;
+        uint32_t stripped_index = 0;
+        for(const BTOKEN& token : bytecode){
+            if(token.token_type != BTOKEN_TYPE::LABEL){
+                stripped_index++;
+                continue;
+            }
+            const uint32_t label_id = token.data.number_value;
+            if(label_id >= label_addresses.size()){
+                label_addresses.resize(label_id + 1, 0);
+            }
+            label_addresses[label_id] = stripped_index;
+        }
+
+        RFC_HEADER header{};
+        std::memcpy(header.magic, "RFC", 4);
+        header.version = RFC_VERSION;
+        header.source_hash = source_hash;
+        header.btoken_size = sizeof(BTOKEN);
+        header.bytecode_count = bytecode.size();
+        header.label_count = label_addresses.size();
+        header.string_count = string_hasher.hashed_strings.size();
+        header.enum_count = enum_map.size();
+
+        std::string out;
+        auto write_raw = [&](const void* data, size_t bytes){ out.append(static_cast<const char*>(data), bytes); };
+        auto write_u32 = [&](uint32_t value){ write_raw(&value, sizeof(value)); };
+
+        write_raw(&header, sizeof(header));
+        write_raw(bytecode.data(), bytecode.size() * sizeof(BTOKEN));
+
+        for(uint32_t address : label_addresses){
+            write_u32(address);
+        }
+
+        for(const auto& str : string_hasher.hashed_strings){
+            write_u32(str.size());
+            write_raw(str.data(), str.size());
+        }
+
+        for(const auto& [type_id, values] : enum_map){
+            write_u32(type_id);
+            write_u32(values.size());
+            for(int value : values){
+                write_u32(value);
+            }
+        }
+
+        // write next to the target and rename so a concurrent run never maps a half written file,
+        // the tmp name is per process so concurrent runs of one script don't write into the same file
+        std::random_device random;
+        const std::string tmp_path = cache_path + "." + std::to_string(current_process_id()) + "-" +
+                                     std::to_string(random()) + ".tmp";
+        {
+            std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+            if(!file.is_open()){
+                return;
+            }
+            file.write(out.data(), out.size());
+            if(!file){
+                file.close();
+                std::remove(tmp_path.c_str());
+                return;
+            }
+        }
+#ifdef _WIN32
+        // rename() won't replace an existing file on Windows, a stale cache would never be updated.
+        // A run in between finds no cache and recompiles, which is all a missing cache costs.
+        std::remove(cache_path.c_str());
+#endif
+        if(std::rename(tmp_path.c_str(), cache_path.c_str()) != 0){
+            std::remove(tmp_path.c_str());
+        }
+    }
+};
+
+#endif
@@ -11,7 +11,7 @@
 
 struct STRING_HASHER{
     public:
-        std::unordered_map<std::string, uint16_t>string_to_hash;
+        std::unordered_map<std::string, uint32_t>string_to_hash;
         std::vector<std::string>hashed_strings;
         void fill_hashed_strings(){
             hashed_strings.resize(string_to_hash.size());
@@ -29,13 +29,16 @@ struct STRING_HASHER{
 
 struct GOTO_HASHER{
     public:
-        std::unordered_map<uint16_t , uint16_t>label_to_address;
-        std::vector<int>hashed_goto_positions; // index is label name, value is address in bytecode
+        std::unordered_map<uint32_t, uint32_t>label_to_address;
+        std::vector<uint32_t>hashed_goto_positions; // index is label name, value is address in bytecode
         
-        void add_label(uint16_t address){
-            uint16_t label_name = label_to_address.size();
+        void add_label(uint32_t address){
+            if(label_to_address.size() == UINT32_MAX){
+                throw_error("Too many labels in program!");
+            }
+            uint32_t label_name = label_to_address.size();
             if(label_to_address.find(label_name) != label_to_address.end()){
-                throw_error("Duplicate label found in GOTO hasher: " + label_name);
+                throw_error("Duplicate label found in GOTO hasher: " + std::to_string(label_name));
             }
             label_to_address[label_name] = address;
         }
@@ -47,7 +50,7 @@ struct GOTO_HASHER{
             }
         }
 
-        void set_label_address(uint16_t label_name, uint16_t address){
+        void set_label_address(uint32_t label_name, uint32_t address){
             if(label_to_address.find(label_name) == label_to_address.end()){
                 throw_error("Label not found in GOTO hasher: " + std::to_string(label_name));
             }
@@ -0,0 +1,539 @@
+// Kernels behind whole-array expressions (c = a + b, a = a * 2.0), the reductions (sum(a), dot_product(a, b))
+// and the matrix intrinsics (matmul(a, b), transpose(a))
+// they run over contiguous doubles, on x86 the widest vector unit the CPU has is picked once at
+// run time (AVX2, else SSE2), other targets and the tail of every array go through the scalar loop
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define RF_X86_KERNELS 1
+#include <immintrin.h>
+#define RF_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define RF_X86_KERNELS 0
+#endif
+
+enum class SIMD_LEVEL : uint8_t {
+    SCALAR,
+    SSE2,
+    AVX2,
+};
+
+inline SIMD_LEVEL simd_level(){
+#if RF_X86_KERNELS
+    static const SIMD_LEVEL level = __builtin_cpu_supports("avx2") ? SIMD_LEVEL::AVX2 : SIMD_LEVEL::SSE2;
+    return level;
+#else
+    return SIMD_LEVEL::SCALAR;
+#endif
+}
+
+// one side of an element-wise operation, a whole array or a scalar repeated for every element
+struct KERNEL_OPERAND {
+    const double* data = nullptr; // nullptr for a scalar
+    double scalar = 0;
+};
+
+// -------------------- Operators --------------------
+
+#if RF_X86_KERNELS
+#define RF_KERNEL_OP(name, expr, sse, avx) \
+    struct name { \
+        static inline double apply(double a, double b){ return expr; } \
+        static inline __m128d apply(__m128d a, __m128d b){ return sse(a, b); } \
+        RF_TARGET_AVX2 static inline __m256d apply(__m256d a, __m256d b){ return avx(a, b); } \
+    };
+#else
+#define RF_KERNEL_OP(name, expr, sse, avx) \
+    struct name { \
+        static inline double apply(double a, double b){ return expr; } \
+    };
+#endif
+
+RF_KERNEL_OP(KERNEL_ADD, a + b, _mm_add_pd, _mm256_add_pd)
+RF_KERNEL_OP(KERNEL_SUB, a - b, _mm_sub_pd, _mm256_sub_pd)
+RF_KERNEL_OP(KERNEL_MUL, a * b, _mm_mul_pd, _mm256_mul_pd)
+RF_KERNEL_OP(KERNEL_DIV, a / b, _mm_div_pd, _mm256_div_pd)
+
+#undef RF_KERNEL_OP
+
+// -------------------- Loops --------------------
+// out may be the same buffer as an array operand, every element is read before it is written
+
+template<typename OP, bool LHS_ARRAY, bool RHS_ARRAY>
+static inline void scalar_kernel(double* out, KERNEL_OPERAND lhs, KERNEL_OPERAND rhs, size_t i, size_t n){
+    for(; i < n; i++){
+        out[i] = OP::apply(LHS_ARRAY ? lhs.data[i] : lhs.scalar, RHS_ARRAY ? rhs.data[i] : rhs.scalar);
+    }
+}
+
+#if RF_X86_KERNELS
+
+template<typename OP, bool LHS_ARRAY, bool RHS_ARRAY>
+static void sse2_kernel(double* out, KERNEL_OPERAND lhs, KERNEL_OPERAND rhs, size_t n){
+    const __m128d lhs_scalar = _mm_set1_pd(lhs.scalar);
+    const __m128d rhs_scalar = _mm_set1_pd(rhs.scalar);
+    size_t i = 0;
+
+    // two vectors per iteration keep both ports of the FP unit busy
+    for(; i + 4 <= n; i += 4){
+        const __m128d l0 = LHS_ARRAY ? _mm_loadu_pd(lhs.data + i) : lhs_scalar;
+        const __m128d l1 = LHS_ARRAY ? _mm_loadu_pd(lhs.data + i + 2) : lhs_scalar;
+        const __m128d r0 = RHS_ARRAY ? _mm_loadu_pd(rhs.data + i) : rhs_scalar;
+        const __m128d r1 = RHS_ARRAY ? _mm_loadu_pd(rhs.data + i + 2) : rhs_scalar;
+        _mm_storeu_pd(out + i, OP::apply(l0, r0));
+        _mm_storeu_pd(out + i + 2, OP::apply(l1, r1));
+    }
+
+    scalar_kernel<OP, LHS_ARRAY, RHS_ARRAY>(out, lhs, rhs, i, n);
+}
+
+template<typename OP, bool LHS_ARRAY, bool RHS_ARRAY>
+RF_TARGET_AVX2 static void avx2_kernel(double* out, KERNEL_OPERAND lhs, KERNEL_OPERAND rhs, size_t n){
+    const __m256d lhs_scalar = _mm256_set1_pd(lhs.scalar);
+    const __m256d rhs_scalar = _mm256_set1_pd(rhs.scalar);
+    size_t i = 0;
+
+    for(; i + 8 <= n; i += 8){
+        const __m256d l0 = LHS_ARRAY ? _mm256_loadu_pd(lhs.data + i) : lhs_scalar;
+        const __m256d l1 = LHS_ARRAY ? _mm256_loadu_pd(lhs.data + i + 4) : lhs_scalar;
+        const __m256d r0 = RHS_ARRAY ? _mm256_loadu_pd(rhs.data + i) : rhs_scalar;
+        const __m256d r1 = RHS_ARRAY ? _mm256_loadu_pd(rhs.data + i + 4) : rhs_scalar;
+        _mm256_storeu_pd(out + i, OP::apply(l0, r0));
+        _mm256_storeu_pd(out + i + 4, OP::apply(l1, r1));
+    }
+    if(i + 4 <= n){
+        const __m256d l0 = LHS_ARRAY ? _mm256_loadu_pd(lhs.data + i) : lhs_scalar;
+        const __m256d r0 = RHS_ARRAY ? _mm256_loadu_pd(rhs.data + i) : rhs_scalar;
+        _mm256_storeu_pd(out + i, OP::apply(l0, r0));
+        i += 4;
+    }
+
+    scalar_kernel<OP, LHS_ARRAY, RHS_ARRAY>(out, lhs, rhs, i, n);
+}
+
+#endif
+
+template<typename OP, bool LHS_ARRAY, bool RHS_ARRAY>
+static inline void run_kernel(double* out, KERNEL_OPERAND lhs, KERNEL_OPERAND rhs, size_t n){
+    switch(simd_level()){
+#if RF_X86_KERNELS
+        case SIMD_LEVEL::AVX2: avx2_kernel<OP, LHS_ARRAY, RHS_ARRAY>(out, lhs, rhs, n); return;
+        case SIMD_LEVEL::SSE2: sse2_kernel<OP, LHS_ARRAY, RHS_ARRAY>(out, lhs, rhs, n); return;
+#endif
+        default: scalar_kernel<OP, LHS_ARRAY, RHS_ARRAY>(out, lhs, rhs, 0, n); return;
+    }
+}
+
+template<typename OP>
+static inline void run_kernel(double* out, KERNEL_OPERAND lhs, KERNEL_OPERAND rhs, size_t n){
+    if(lhs.data && rhs.data){
+        run_kernel<OP, true, true>(out, lhs, rhs, n);
+    }else if(lhs.data){
+        run_kernel<OP, true, false>(out, lhs, rhs, n);
+    }else{
+        run_kernel<OP, false, true>(out, lhs, rhs, n);
+    }
+}
+
+// out[i] = lhs[i] op rhs[i] for i < n, op is '+', '-', '*' or '/' as in OP instructions,
+// at least one side must be an array. Returns false for any other op.
+inline bool elementwise_kernel(double* out, KERNEL_OPERAND lhs, KERNEL_OPERAND rhs, size_t n, unsigned char op){
+    switch(op){
+        case '+': run_kernel<KERNEL_ADD>(out, lhs, rhs, n); return true;
+        case '-': run_kernel<KERNEL_SUB>(out, lhs, rhs, n); return true;
+        case '*': run_kernel<KERNEL_MUL>(out, lhs, rhs, n); return true;
+        case '/': run_kernel<KERNEL_DIV>(out, lhs, rhs, n); return true;
+        default: return false;
+    }
+}
+
+// -------------------- Reductions --------------------
+// every loop keeps four independent accumulators so consecutive operations don't wait on each other,
+// sums and products can therefore differ from a left to right loop in the last bits
+
+#if RF_X86_KERNELS
+#define RF_REDUCE_OP(name, identity_value, scalar_apply, sse_apply, avx_apply, scalar_combine, sse_combine, avx_combine) \
+    struct name { \
+        static constexpr double identity = identity_value; \
+        static inline double apply(double acc, double x){ return scalar_apply; } \
+        static inline double combine(double acc, double x){ return scalar_combine; } \
+        static inline __m128d apply(__m128d acc, __m128d x){ return sse_apply; } \
+        static inline __m128d combine(__m128d acc, __m128d x){ return sse_combine; } \
+        RF_TARGET_AVX2 static inline __m256d apply(__m256d acc, __m256d x){ return avx_apply; } \
+        RF_TARGET_AVX2 static inline __m256d combine(__m256d acc, __m256d x){ return avx_combine; } \
+    };
+#else
+#define RF_REDUCE_OP(name, identity_value, scalar_apply, sse_apply, avx_apply, scalar_combine, sse_combine, avx_combine) \
+    struct name { \
+        static constexpr double identity = identity_value; \
+        static inline double apply(double acc, double x){ return scalar_apply; } \
+        static inline double combine(double acc, double x){ return scalar_combine; } \
+    };
+#endif
+
+RF_REDUCE_OP(REDUCE_SUM, 0.0,
+    acc + x, _mm_add_pd(acc, x), _mm256_add_pd(acc, x),
+    acc + x, _mm_add_pd(acc, x), _mm256_add_pd(acc, x))
+RF_REDUCE_OP(REDUCE_PRODUCT, 1.0,
+    acc * x, _mm_mul_pd(acc, x), _mm256_mul_pd(acc, x),
+    acc * x, _mm_mul_pd(acc, x), _mm256_mul_pd(acc, x))
+RF_REDUCE_OP(REDUCE_MIN, __builtin_huge_val(),
+    x < acc ? x : acc, _mm_min_pd(x, acc), _mm256_min_pd(x, acc),
+    x < acc ? x : acc, _mm_min_pd(x, acc), _mm256_min_pd(x, acc))
+RF_REDUCE_OP(REDUCE_MAX, -__builtin_huge_val(),
+    x > acc ? x : acc, _mm_max_pd(x, acc), _mm256_max_pd(x, acc),
+    x > acc ? x : acc, _mm_max_pd(x, acc), _mm256_max_pd(x, acc))
+// counts the elements that aren't zero, a compare mask ANDed with 1.0 adds one per lane
+RF_REDUCE_OP(REDUCE_COUNT, 0.0,
+    acc + (x != 0 ? 1.0 : 0.0),
+    _mm_add_pd(acc, _mm_and_pd(_mm_cmpneq_pd(x, _mm_setzero_pd()), _mm_set1_pd(1.0))),
+    _mm256_add_pd(acc, _mm256_and_pd(_mm256_cmp_pd(x, _mm256_setzero_pd(), _CMP_NEQ_UQ), _mm256_set1_pd(1.0))),
+    acc + x, _mm_add_pd(acc, x), _mm256_add_pd(acc, x))
+
+#undef RF_REDUCE_OP
+
+template<typename OP>
+static inline double scalar_reduce(const double* data, size_t i, size_t n){
+    double acc[4] = {OP::identity, OP::identity, OP::identity, OP::identity};
+    for(; i + 4 <= n; i += 4){
+        for(int k = 0; k < 4; k++){
+            acc[k] = OP::apply(acc[k], data[i + k]);
+        }
+    }
+    for(; i < n; i++){
+        acc[0] = OP::apply(acc[0], data[i]);
+    }
+    return OP::combine(OP::combine(acc[0], acc[1]), OP::combine(acc[2], acc[3]));
+}
+
+#if RF_X86_KERNELS
+
+template<typename OP>
+static double sse2_reduce(const double* data, size_t n){
+    __m128d acc[4];
+    for(int k = 0; k < 4; k++){ acc[k] = _mm_set1_pd(OP::identity); }
+
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8){
+        for(int k = 0; k < 4; k++){
+            acc[k] = OP::apply(acc[k], _mm_loadu_pd(data + i + 2 * k));
+        }
+    }
+
+    double lanes[2];
+    _mm_storeu_pd(lanes, OP::combine(OP::combine(acc[0], acc[1]), OP::combine(acc[2], acc[3])));
+    return OP::combine(OP::combine(lanes[0], lanes[1]), scalar_reduce<OP>(data, i, n));
+}
+
+template<typename OP>
+RF_TARGET_AVX2 static double avx2_reduce(const double* data, size_t n){
+    __m256d acc[4];
+    for(int k = 0; k < 4; k++){ acc[k] = _mm256_set1_pd(OP::identity); }
+
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16){
+        for(int k = 0; k < 4; k++){
+            acc[k] = OP::apply(acc[k], _mm256_loadu_pd(data + i + 4 * k));
+        }
+    }
+
+    double lanes[4];
+    _mm256_storeu_pd(lanes, OP::combine(OP::combine(acc[0], acc[1]), OP::combine(acc[2], acc[3])));
+    return OP::combine(OP::combine(OP::combine(lanes[0], lanes[1]), OP::combine(lanes[2], lanes[3])),
+                       scalar_reduce<OP>(data, i, n));
+}
+
+#endif
+
+template<typename OP>
+static inline double run_reduce(const double* data, size_t n){
+    switch(simd_level()){
+#if RF_X86_KERNELS
+        case SIMD_LEVEL::AVX2: return avx2_reduce<OP>(data, n);
+        case SIMD_LEVEL::SSE2: return sse2_reduce<OP>(data, n);
+#endif
+        default: return scalar_reduce<OP>(data, 0, n);
+    }
+}
+
+// reduction of data[0 .. n): '+' sum, '*' product, '<' minimum, '>' maximum, '#' count of non-zero
+// elements. The minimum and maximum of nothing are +inf and -inf. Returns false for any other op.
+inline bool reduce_kernel(const double* data, size_t n, unsigned char op, double& result){
+    switch(op){
+        case '+': result = run_reduce<REDUCE_SUM>(data, n); return true;
+        case '*': result = run_reduce<REDUCE_PRODUCT>(data, n); return true;
+        case '<': result = run_reduce<REDUCE_MIN>(data, n); return true;
+        case '>': result = run_reduce<REDUCE_MAX>(data, n); return true;
+        case '#': result = run_reduce<REDUCE_COUNT>(data, n); return true;
+        default: return false;
+    }
+}
+
+// -------------------- Dot product --------------------
+
+static inline double scalar_dot(const double* a, const double* b, size_t i, size_t n){
+    double acc[4] = {0, 0, 0, 0};
+    for(; i + 4 <= n; i += 4){
+        for(int k = 0; k < 4; k++){
+            acc[k] += a[i + k] * b[i + k];
+        }
+    }
+    for(; i < n; i++){
+        acc[0] += a[i] * b[i];
+    }
+    return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+}
+
+#if RF_X86_KERNELS
+
+static inline double sse2_dot(const double* a, const double* b, size_t n){
+    __m128d acc[4] = {_mm_setzero_pd(), _mm_setzero_pd(), _mm_setzero_pd(), _mm_setzero_pd()};
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8){
+        for(int k = 0; k < 4; k++){
+            acc[k] = _mm_add_pd(acc[k], _mm_mul_pd(_mm_loadu_pd(a + i + 2 * k), _mm_loadu_pd(b + i + 2 * k)));
+        }
+    }
+
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(_mm_add_pd(acc[0], acc[1]), _mm_add_pd(acc[2], acc[3])));
+    return (lanes[0] + lanes[1]) + scalar_dot(a, b, i, n);
+}
+
+RF_TARGET_AVX2 static inline double avx2_dot(const double* a, const double* b, size_t n){
+    __m256d acc[4] = {_mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd()};
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16){
+        for(int k = 0; k < 4; k++){
+            acc[k] = _mm256_add_pd(acc[k], _mm256_mul_pd(_mm256_loadu_pd(a + i + 4 * k), _mm256_loadu_pd(b + i + 4 * k)));
+        }
+    }
+
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(_mm256_add_pd(acc[0], acc[1]), _mm256_add_pd(acc[2], acc[3])));
+    return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + scalar_dot(a, b, i, n);
+}
+
+#endif
+
+// sum of a[i] * b[i] for i < n
+inline double dot_kernel(const double* a, const double* b, size_t n){
+    switch(simd_level()){
+#if RF_X86_KERNELS
+        case SIMD_LEVEL::AVX2: return avx2_dot(a, b, n);
+        case SIMD_LEVEL::SSE2: return sse2_dot(a, b, n);
+#endif
+        default: return scalar_dot(a, b, 0, n);
+    }
+}
+
+// -------------------- Matrix product --------------------
+// c (m x n) += a (m x k) * b (k x n), every matrix column-major. a is packed block by block, MATMUL_MB
+// rows by MATMUL_KB columns so the block stays in L2, into strips of TILE::MR rows that the tile kernel
+// reads front to back. A strip times a 4 column panel of b accumulates in registers for the whole block.
+
+constexpr size_t MATMUL_MB = 128;
+constexpr size_t MATMUL_KB = 256;
+constexpr size_t MATMUL_NR = 4; // columns of c per tile
+
+// tile[r + j * MR] = sum over p of pa[r + p * MR] * pb[j + p * NR]
+struct SCALAR_TILE {
+    static constexpr size_t MR = 4;
+    static void run(const double* pa, const double* pb, size_t kb, double* tile){
+        double acc[MR * MATMUL_NR] = {};
+        for(size_t p = 0; p < kb; p++, pa += MR, pb += MATMUL_NR){
+            for(size_t j = 0; j < MATMUL_NR; j++){
+                for(size_t r = 0; r < MR; r++){
+                    acc[r + j * MR] += pa[r] * pb[j];
+                }
+            }
+        }
+        for(size_t t = 0; t < MR * MATMUL_NR; t++){ tile[t] = acc[t]; }
+    }
+};
+
+#if RF_X86_KERNELS
+
+struct SSE2_TILE {
+    static constexpr size_t MR = 4;
+    static void run(const double* pa, const double* pb, size_t kb, double* tile){
+        __m128d acc[2][MATMUL_NR];
+        for(size_t j = 0; j < MATMUL_NR; j++){ acc[0][j] = acc[1][j] = _mm_setzero_pd(); }
+
+        for(size_t p = 0; p < kb; p++, pa += MR, pb += MATMUL_NR){
+            const __m128d a0 = _mm_loadu_pd(pa);
+            const __m128d a1 = _mm_loadu_pd(pa + 2);
+            for(size_t j = 0; j < MATMUL_NR; j++){
+                const __m128d bj = _mm_set1_pd(pb[j]);
+                acc[0][j] = _mm_add_pd(acc[0][j], _mm_mul_pd(a0, bj));
+                acc[1][j] = _mm_add_pd(acc[1][j], _mm_mul_pd(a1, bj));
+            }
+        }
+        for(size_t j = 0; j < MATMUL_NR; j++){
+            _mm_storeu_pd(tile + j * MR, acc[0][j]);
+            _mm_storeu_pd(tile + j * MR + 2, acc[1][j]);
+        }
+    }
+};
+
+struct AVX2_TILE {
+    static constexpr size_t MR = 8;
+    RF_TARGET_AVX2 static void run(const double* pa, const double* pb, size_t kb, double* tile){
+        __m256d acc[2][MATMUL_NR];
+        for(size_t j = 0; j < MATMUL_NR; j++){ acc[0][j] = acc[1][j] = _mm256_setzero_pd(); }
+
+        for(size_t p = 0; p < kb; p++, pa += MR, pb += MATMUL_NR){
+            const __m256d a0 = _mm256_loadu_pd(pa);
+            const __m256d a1 = _mm256_loadu_pd(pa + 4);
+            for(size_t j = 0; j < MATMUL_NR; j++){
+                const __m256d bj = _mm256_broadcast_sd(pb + j);
+                acc[0][j] = _mm256_add_pd(acc[0][j], _mm256_mul_pd(a0, bj));
+                acc[1][j] = _mm256_add_pd(acc[1][j], _mm256_mul_pd(a1, bj));
+            }
+        }
+        for(size_t j = 0; j < MATMUL_NR; j++){
+            _mm256_storeu_pd(tile + j * MR, acc[0][j]);
+            _mm256_storeu_pd(tile + j * MR + 4, acc[1][j]);
+        }
+    }
+};
+
+#endif
+
+template<typename TILE>
+static void blocked_matmul(double* c, const double* a, const double* b, size_t m, size_t k, size_t n){
+    constexpr size_t MR = TILE::MR;
+    const size_t strips = (std::min(m, MATMUL_MB) + MR - 1) / MR;
+    std::vector<double> packed_a(strips * MR * MATMUL_KB);
+    std::vector<double> packed_b(MATMUL_KB * MATMUL_NR);
+    double tile[MR * MATMUL_NR];
+
+    for(size_t p0 = 0; p0 < k; p0 += MATMUL_KB){
+        const size_t kb = std::min(MATMUL_KB, k - p0);
+
+        for(size_t i0 = 0; i0 < m; i0 += MATMUL_MB){
+            const size_t mb = std::min(MATMUL_MB, m - i0);
+
+            // strips of MR rows, row after row for every column of the block, rows past m are zero
+            double* out = packed_a.data();
+            for(size_t is = 0; is < mb; is += MR){
+                const size_t rows = std::min(MR, mb - is);
+                for(size_t p = 0; p < kb; p++){
+                    const double* column = a + (p0 + p) * m + i0 + is;
+                    for(size_t r = 0; r < MR; r++){ *out++ = r < rows ? column[r] : 0.0; }
+                }
+            }
+
+            for(size_t j0 = 0; j0 < n; j0 += MATMUL_NR){
+                const size_t cols = std::min(MATMUL_NR, n - j0);
+
+                // the panel of b interleaved by column, columns past n are zero
+                for(size_t p = 0; p < kb; p++){
+                    for(size_t j = 0; j < MATMUL_NR; j++){
+                        packed_b[p * MATMUL_NR + j] = j < cols ? b[(j0 + j) * k + p0 + p] : 0.0;
+                    }
+                }
+
+                for(size_t is = 0; is < mb; is += MR){
+                    TILE::run(packed_a.data() + is * kb, packed_b.data(), kb, tile);
+
+                    const size_t rows = std::min(MR, mb - is);
+                    for(size_t j = 0; j < cols; j++){
+                        double* column = c + (j0 + j) * m + i0 + is;
+                        for(size_t r = 0; r < rows; r++){ column[r] += tile[r + j * MR]; }
+                    }
+                }
+            }
+        }
+    }
+}
+
+// c += a * b with a m x k, b k x n and c m x n, all column-major
+inline void matmul_kernel(double* c, const double* a, const double* b, size_t m, size_t k, size_t n){
+    switch(simd_level()){
+#if RF_X86_KERNELS
+        case SIMD_LEVEL::AVX2: blocked_matmul<AVX2_TILE>(c, a, b, m, k, n); return;
+        case SIMD_LEVEL::SSE2: blocked_matmul<SSE2_TILE>(c, a, b, m, k, n); return;
+#endif
+        default: blocked_matmul<SCALAR_TILE>(c, a, b, m, k, n); return;
+    }
+}
+
+// -------------------- Transpose --------------------
+// out (n x m) = transpose of in (m x n), column-major. Done in TRANSPOSE_BLOCK square blocks so the
+// columns being read and the ones being written both stay in cache.
+
+constexpr size_t TRANSPOSE_BLOCK = 32;
+
+template<typename T>
+static void scalar_transpose(T* out, const T* in, size_t m, size_t n, size_t i0, size_t i1, size_t j0, size_t j1){
+    for(size_t j = j0; j < j1; j++){
+        for(size_t i = i0; i < i1; i++){
+            out[j + i * n] = in[i + j * m];
+        }
+    }
+}
+
+template<typename T>
+static void blocked_transpose(T* out, const T* in, size_t m, size_t n){
+    for(size_t j0 = 0; j0 < n; j0 += TRANSPOSE_BLOCK){
+        for(size_t i0 = 0; i0 < m; i0 += TRANSPOSE_BLOCK){
+            scalar_transpose(out, in, m, n, i0, std::min(i0 + TRANSPOSE_BLOCK, m), j0, std::min(j0 + TRANSPOSE_BLOCK, n));
+        }
+    }
+}
+
+#if RF_X86_KERNELS
+
+// 4 x 4 blocks in registers: four columns in, unpack pairs of them, swap the 128 bit halves, four rows out
+RF_TARGET_AVX2 static void avx2_transpose(double* out, const double* in, size_t m, size_t n){
+    for(size_t j0 = 0; j0 < n; j0 += TRANSPOSE_BLOCK){
+        const size_t j1 = std::min(j0 + TRANSPOSE_BLOCK, n);
+        for(size_t i0 = 0; i0 < m; i0 += TRANSPOSE_BLOCK){
+            const size_t i1 = std::min(i0 + TRANSPOSE_BLOCK, m);
+
+            size_t j = j0;
+            for(; j + 4 <= j1; j += 4){
+                size_t i = i0;
+                for(; i + 4 <= i1; i += 4){
+                    const __m256d c0 = _mm256_loadu_pd(in + i + (j + 0) * m);
+                    const __m256d c1 = _mm256_loadu_pd(in + i + (j + 1) * m);
+                    const __m256d c2 = _mm256_loadu_pd(in + i + (j + 2) * m);
+                    const __m256d c3 = _mm256_loadu_pd(in + i + (j + 3) * m);
+                    const __m256d lo01 = _mm256_unpacklo_pd(c0, c1);
+                    const __m256d hi01 = _mm256_unpackhi_pd(c0, c1);
+                    const __m256d lo23 = _mm256_unpacklo_pd(c2, c3);
+                    const __m256d hi23 = _mm256_unpackhi_pd(c2, c3);
+                    _mm256_storeu_pd(out + j + (i + 0) * n, _mm256_permute2f128_pd(lo01, lo23, 0x20));
+                    _mm256_storeu_pd(out + j + (i + 1) * n, _mm256_permute2f128_pd(hi01, hi23, 0x20));
+                    _mm256_storeu_pd(out + j + (i + 2) * n, _mm256_permute2f128_pd(lo01, lo23, 0x31));
+                    _mm256_storeu_pd(out + j + (i + 3) * n, _mm256_permute2f128_pd(hi01, hi23, 0x31));
+                }
+                scalar_transpose(out, in, m, n, i, i1, j, j + 4);
+            }
+            scalar_transpose(out, in, m, n, i0, i1, j, j1);
+        }
+    }
+}
+
+#endif
+
+// out = transpose of in with in m x n and out n x m, both column-major
+inline void transpose_kernel(double* out, const double* in, size_t m, size_t n){
+#if RF_X86_KERNELS
+    if(simd_level() == SIMD_LEVEL::AVX2){
+        avx2_transpose(out, in, m, n);
+        return;
+    }
+#endif
+    blocked_transpose(out, in, m, n);
+}
+
+#endif
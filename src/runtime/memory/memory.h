@@ -10,12 +10,15 @@
 #include <iostream>
 #include <algorithm>
 #include <unordered_map>
+#include <vector>
 #include "hasher.h"
+#include "../../error/error.h"
 
 #pragma GCC optimize("Ofast","unroll-loops","fast-math")
 
-#define MAX_MEM UINT8_MAX
 #define MAX_ENUM 20
+#define MAX_ARRAY_LEN (1u << 24) // elements per array, guards against runaway indices
+#define MAX_ARRAY_RANK 3         // dimensions of var m(d1, d2, d3)
 
 enum class VALUE_TYPE : uint8_t{
     NUMBER,
@@ -23,14 +26,81 @@ enum class VALUE_TYPE : uint8_t{
     STRING,
     ARRAY,
     ENUM_OBJECT,
+    INTEGER, // values of `integer` variables, +, - and * on two of them wrap instead of rounding
 };
 
+// Both layouts below expose the same accessors, the VM never touches the representation directly.
+
+#ifdef RF_NAN_BOXING
+
+// NaN-boxed value, 8 bytes. Numbers are stored as plain doubles, every other type lives in the
+// payload of a negative quiet NaN whose top 16 bits are 0xFFF8 + VALUE_TYPE. 0xFFF8 itself is the
+// NaN x86 hands out for 0/0, so it stays a number and the first boxed tag is 0xFFF9 (NONE).
+// Integers only get the 48 payload bits here, storing one outside [-2^47, 2^47) stops the program
+// instead of silently dropping its top bits.
+struct VALUE{
+
+    union {
+        double number_value;
+        uint64_t bits;
+    };
+
+    static constexpr int TAG_SHIFT = 48;
+    static constexpr uint64_t TAG_BASE = 0xFFF8;
+    static constexpr uint64_t FIRST_BOXED = (TAG_BASE + 1) << TAG_SHIFT;
+    static constexpr uint64_t PAYLOAD_MASK = (uint64_t(1) << TAG_SHIFT) - 1;
+
+    static constexpr uint64_t box(VALUE_TYPE type, uint64_t payload){
+        return ((TAG_BASE + static_cast<uint64_t>(type)) << TAG_SHIFT) | payload;
+    }
+
+    VALUE() : bits(box(VALUE_TYPE::NONE, 0)) {}
+
+    inline bool is_number() const { return bits < FIRST_BOXED; }
+    inline VALUE_TYPE type() const {
+        return is_number() ? VALUE_TYPE::NUMBER : static_cast<VALUE_TYPE>((bits >> TAG_SHIFT) - TAG_BASE);
+    }
+
+    inline bool is_integer() const { return (bits >> TAG_SHIFT) == TAG_BASE + static_cast<uint64_t>(VALUE_TYPE::INTEGER); }
+
+    inline double number() const { return number_value; }
+    inline int64_t integer() const { return static_cast<int64_t>(bits << (64 - TAG_SHIFT)) >> (64 - TAG_SHIFT); }
+    inline uint32_t string_id() const { return static_cast<uint32_t>(bits); }
+    inline uint32_t array_id() const { return static_cast<uint32_t>(bits); }
+    inline uint8_t enum_type() const { return static_cast<uint8_t>(bits >> 8); }
+    inline uint8_t enum_value() const { return static_cast<uint8_t>(bits); }
+
+    inline void set_number(double value){ number_value = value; }
+    inline void set_integer(int64_t value){
+        bits = box(VALUE_TYPE::INTEGER, static_cast<uint64_t>(value) & PAYLOAD_MASK);
+        if(__builtin_expect(integer() != value, 0)){
+            integer_out_of_range();
+        }
+    }
+    inline void set_string(uint32_t id){ bits = box(VALUE_TYPE::STRING, id); }
+    inline void set_array(uint32_t id){ bits = box(VALUE_TYPE::ARRAY, id); }
+    inline void set_enum(uint8_t type_id, uint8_t value_id){ bits = box(VALUE_TYPE::ENUM_OBJECT, (uint64_t(type_id) << 8) | value_id); }
+    inline void set_none(){ bits = box(VALUE_TYPE::NONE, 0); }
+
+    static inline VALUE make_number(double value){ VALUE v; v.set_number(value); return v; }
+
+    __attribute__((cold, noinline)) [[noreturn]] static void integer_out_of_range(){
+        throw_error("Integer doesn't fit the 48 bits of a NaN-boxed value!");
+    }
+};
+
+static_assert(sizeof(VALUE) == 8, "NaN-boxed VALUE must stay 8 bytes");
+
+#else
+
+// tagged value, the payload union plus a separate VALUE_TYPE (16 bytes)
 struct VALUE{
 
     union {
         double number_value; 
-        uint16_t string_pointer_to_string_hash_array; // will pre computed string hash array later
-        uint8_t array_pointer; // will pre compute later 
+        int64_t integer_value;
+        uint32_t string_pointer_to_string_hash_array; // will pre computed string hash array later
+        uint32_t array_handle; // index into MEMORY::array_memory
         struct {
             uint8_t type_id; // which enum type
             uint8_t value_id; // which value in that enum
@@ -39,12 +109,280 @@ struct VALUE{
     } data;
 
     VALUE_TYPE value_type = VALUE_TYPE::NONE;
+
+    inline bool is_number() const { return value_type == VALUE_TYPE::NUMBER; }
+    inline bool is_integer() const { return value_type == VALUE_TYPE::INTEGER; }
+    inline VALUE_TYPE type() const { return value_type; }
+
+    inline double number() const { return data.number_value; }
+    inline int64_t integer() const { return data.integer_value; }
+    inline uint32_t string_id() const { return data.string_pointer_to_string_hash_array; }
+    inline uint32_t array_id() const { return data.array_handle; }
+    inline uint8_t enum_type() const { return data.enum_data.type_id; }
+    inline uint8_t enum_value() const { return data.enum_data.value_id; }
+
+    inline void set_number(double value){ value_type = VALUE_TYPE::NUMBER; data.number_value = value; }
+    inline void set_integer(int64_t value){ value_type = VALUE_TYPE::INTEGER; data.integer_value = value; }
+    inline void set_string(uint32_t id){ value_type = VALUE_TYPE::STRING; data.string_pointer_to_string_hash_array = id; }
+    inline void set_array(uint32_t id){ value_type = VALUE_TYPE::ARRAY; data.array_handle = id; }
+    inline void set_enum(uint8_t type_id, uint8_t value_id){ value_type = VALUE_TYPE::ENUM_OBJECT; data.enum_data.type_id = type_id; data.enum_data.value_id = value_id; }
+    inline void set_none(){ value_type = VALUE_TYPE::NONE; }
+
+    static inline VALUE make_number(double value){ VALUE v; v.set_number(value); return v; }
+};
+
+#endif
+
+// numbers and integers mix in arithmetic and comparisons, the result is a number unless both are integers
+inline bool is_numeric(const VALUE& value){ return value.is_number() || value.is_integer(); }
+inline double numeric_value(const VALUE& value){ return value.is_integer() ? static_cast<double>(value.integer()) : value.number(); }
+
+// -------------------- Arrays --------------------
+// An array whose elements all are numbers or all are integers keeps them unboxed and contiguous,
+// 8 bytes each with one type tag for the whole array, so kernels and memcpy work on it directly.
+// Storing an element of another type, or writing past the end (the gap holds NONE), turns it into
+// tagged VALUEs until the next literal fills it anew.
+// Arrays declared with extents (var m(3, 4)) are stored column-major like Fortran, m[i, j] sits at
+// i * strides[0] + j * strides[1], and keep their size, only arrays of rank 1 grow. They also keep
+// their element type, numbers and integers stored into them are converted like for `integer` variables.
+
+enum class ARRAY_LAYOUT : uint8_t {
+    NUMBERS,  // numbers
+    INTEGERS, // integers
+    VALUES,   // tagged, anything goes
+};
+
+inline ARRAY_LAYOUT layout_of(const VALUE& value){
+    return value.is_number() ? ARRAY_LAYOUT::NUMBERS : value.is_integer() ? ARRAY_LAYOUT::INTEGERS : ARRAY_LAYOUT::VALUES;
+}
+
+struct ARRAY_SHAPE{
+    uint8_t rank = 1;                       // literals and appended-to arrays have one dimension
+    uint32_t extents[MAX_ARRAY_RANK] = {};  // rank > 1 only, rank 1 arrays take their extent from size()
+    uint32_t strides[MAX_ARRAY_RANK] = {};  // elements between neighbours of every dimension, strides[0] is 1
+};
+
+struct ARRAY{
+
+    ARRAY_LAYOUT layout = ARRAY_LAYOUT::NUMBERS;
+    ARRAY_SHAPE shape;
+    bool typed = false; // declared with extents, see allocate()
+    std::vector<double> numbers;   // NUMBERS
+    std::vector<int64_t> integers; // INTEGERS
+    std::vector<VALUE> values;     // VALUES
+
+    inline size_t size() const {
+        switch(layout){
+            case ARRAY_LAYOUT::NUMBERS: return numbers.size();
+            case ARRAY_LAYOUT::INTEGERS: return integers.size();
+            default: return values.size();
+        }
+    }
+
+    // element at index < size()
+    inline VALUE at(size_t index) const {
+        VALUE value;
+        switch(layout){
+            case ARRAY_LAYOUT::NUMBERS: value.set_number(numbers[index]); break;
+            case ARRAY_LAYOUT::INTEGERS: value.set_integer(integers[index]); break;
+            default: value = values[index]; break;
+        }
+        return value;
+    }
+
+    // element at index = value, growing the array when index is at or past its end
+    __attribute__((noinline)) void set(size_t index, const VALUE& value){
+        const size_t count = this->size();
+        if(index >= count && shape.rank > 1){
+            throw_error("Array index is out of bounds!"); // arrays with extents keep their size
+        }
+        if(typed && layout != ARRAY_LAYOUT::VALUES && is_numeric(value) && index <= count){
+            this->set_converted(index, count, value);
+            return;
+        }
+        if(count == 0){
+            this->layout = layout_of(value); // an empty array takes the type of its first element
+        }
+        if(index > count || layout_of(value) != this->layout){
+            this->to_values();
+        }
+
+        switch(layout){
+            case ARRAY_LAYOUT::NUMBERS:
+                if(index == count){ numbers.push_back(value.number()); }else{ numbers[index] = value.number(); }
+                break;
+            case ARRAY_LAYOUT::INTEGERS:
+                if(index == count){ integers.push_back(value.integer()); }else{ integers[index] = value.integer(); }
+                break;
+            default:
+                if(index >= count){ values.resize(index + 1); }
+                values[index] = value;
+                break;
+        }
+    }
+
+    // replaces the elements, the layout is picked from their types
+    __attribute__((noinline)) void assign(const VALUE* first, size_t count){
+        ARRAY_LAYOUT target = count == 0 ? ARRAY_LAYOUT::NUMBERS : layout_of(first[0]);
+        for(size_t i = 1; i < count && target != ARRAY_LAYOUT::VALUES; i++){
+            if(layout_of(first[i]) != target){
+                target = ARRAY_LAYOUT::VALUES;
+            }
+        }
+
+        this->clear();
+        this->layout = target;
+        this->shape = ARRAY_SHAPE();
+        this->typed = false;
+        switch(target){
+            case ARRAY_LAYOUT::NUMBERS:
+                numbers.resize(count);
+                for(size_t i = 0; i < count; i++){ numbers[i] = first[i].number(); }
+                break;
+            case ARRAY_LAYOUT::INTEGERS:
+                integers.resize(count);
+                for(size_t i = 0; i < count; i++){ integers[i] = first[i].integer(); }
+                break;
+            default:
+                values.assign(first, first + count);
+                break;
+        }
+    }
+
+    // makes this an array of count numbers and returns them to be overwritten, the contents are kept
+    // when it already is one (the destination of a kernel may be one of its operands)
+    inline double* numbers_for(size_t count){
+        if(layout != ARRAY_LAYOUT::NUMBERS){
+            this->clear();
+            this->layout = ARRAY_LAYOUT::NUMBERS;
+        }
+        numbers.resize(count);
+        return numbers.data();
+    }
+
+    // zero-filled array of numbers or integers with the given extents, count is their product
+    void allocate(const uint32_t* extents, uint8_t rank, size_t count, bool integer){
+        this->clear();
+        this->layout = integer ? ARRAY_LAYOUT::INTEGERS : ARRAY_LAYOUT::NUMBERS;
+        if(integer){
+            integers.assign(count, 0);
+        }else{
+            numbers.assign(count, 0.0);
+        }
+
+        this->typed = true;
+        this->set_extents(extents, rank);
+    }
+
+    // shape of the elements already stored, the product of the extents is size()
+    void set_extents(const uint32_t* extents, uint8_t rank){
+        this->shape = ARRAY_SHAPE();
+        if(rank > 1){
+            this->shape.rank = rank;
+            uint32_t stride = 1;
+            for(uint8_t d = 0; d < rank; d++){
+                this->shape.extents[d] = extents[d];
+                this->shape.strides[d] = stride;
+                stride *= extents[d];
+            }
+        }
+    }
+
+    // after a whole-array result replaced the elements, `declared` and `element_layout` are typed and layout from before:
+    // a declared array converts the result back to its element type like set() does (one element that isn't a number
+    // leaves it tagged), any other array takes the result as it is
+    __attribute__((noinline)) void keep_type(bool declared, ARRAY_LAYOUT element_layout){
+        this->typed = declared;
+        if(!declared || layout == element_layout || element_layout == ARRAY_LAYOUT::VALUES){
+            return;
+        }
+        if(layout == ARRAY_LAYOUT::VALUES){
+            for(const VALUE& value : values){
+                if(!is_numeric(value)){
+                    return;
+                }
+            }
+        }
+
+        const size_t count = this->size();
+        if(element_layout == ARRAY_LAYOUT::INTEGERS){
+            std::vector<int64_t> converted(count);
+            for(size_t i = 0; i < count; i++){ converted[i] = truncated(this->at(i)); }
+            this->clear();
+            integers = std::move(converted);
+        }else{
+            std::vector<double> converted(count);
+            for(size_t i = 0; i < count; i++){ converted[i] = numeric_value(this->at(i)); }
+            this->clear();
+            numbers = std::move(converted);
+        }
+        layout = element_layout;
+    }
+
+    // element-wise operations pair up elements by position, both sides need the same extents
+    inline bool same_shape(const ARRAY& other) const {
+        if(shape.rank != other.shape.rank){
+            return false;
+        }
+        if(shape.rank == 1){
+            return this->size() == other.size();
+        }
+        for(uint8_t d = 0; d < shape.rank; d++){
+            if(shape.extents[d] != other.shape.extents[d]){
+                return false;
+            }
+        }
+        return true;
+    }
+
+    inline void clear(){
+        numbers.clear();
+        integers.clear();
+        values.clear();
+    }
+
+    private:
+        // a number or integer into an array of the other kind, integers truncate toward zero
+        void set_converted(size_t index, size_t count, const VALUE& value){
+            if(layout == ARRAY_LAYOUT::NUMBERS){
+                if(index == count){ numbers.push_back(numeric_value(value)); }else{ numbers[index] = numeric_value(value); }
+                return;
+            }
+
+            const int64_t integer = truncated(value);
+            if(index == count){ integers.push_back(integer); }else{ integers[index] = integer; }
+        }
+
+        // a number or integer as an integer element, numbers truncate toward zero
+        static int64_t truncated(const VALUE& value){
+            if(value.is_integer()){
+                return value.integer();
+            }
+            if(!(value.number() >= -0x1p63 && value.number() < 0x1p63)){
+                throw_error("Number is out of the integer range!");
+            }
+            return static_cast<int64_t>(value.number());
+        }
+
+        inline void to_values(){
+            if(layout == ARRAY_LAYOUT::VALUES){
+                return;
+            }
+            const size_t count = this->size();
+            values.resize(count);
+            for(size_t i = 0; i < count; i++){
+                values[i] = this->at(i);
+            }
+            numbers = {};
+            integers = {};
+            layout = ARRAY_LAYOUT::VALUES;
+        }
 };
 
 struct STACK{
 
     public:
-        VALUE stack[MAX_MEM];
+        std::vector<VALUE> stack; // sized by COMPILER from the deepest point of the program, push never checks
       
     int sp = 0; // stack pointer
     inline void push(const VALUE& val){
@@ -63,9 +401,9 @@ struct STACK{
     inline void list_top(){
         const VALUE& tval = stack[sp-1];
         
-        switch(tval.value_type){
+        switch(tval.type()){
             case VALUE_TYPE::NUMBER:
-                std::cout<<"[Top of Stack] Type: NUMBER Value: "<<tval.data.number_value<<"\n";
+                std::cout<<"[Top of Stack] Type: NUMBER Value: "<<tval.number()<<"\n";
                 break;
            
             case VALUE_TYPE::NONE:
@@ -81,8 +419,8 @@ struct STACK{
 
 struct MEMORY{
 
-    VALUE memory[MAX_MEM];
-    VALUE array_memory[MAX_MEM][MAX_MEM]; // unchanged
+    std::vector<VALUE> memory; // variable slots, sized by COMPILER from the highest slot the bytecode uses
+    std::vector<ARRAY> array_memory; // array heap, indexed by the handle stored in ARRAY values
     std::vector<std::vector<VALUE>> enum_memory; // dynamic enum memory
 
     STACK st;
@@ -116,9 +454,7 @@ struct MEMORY{
             
             for (size_t val_idx = 0; val_idx <enum_memory[type_id].size(); val_idx++) {
                 VALUE v;
-                v.value_type = VALUE_TYPE::ENUM_OBJECT;
-                v.data.enum_data.type_id = type_id;
-                v.data.enum_data.value_id = val_idx;
+                v.set_enum(type_id, val_idx);
             //    std::cout<<type_id<<"\n";
               
                 enum_memory[type_id][val_idx] = v;
@@ -134,21 +470,33 @@ struct MEMORY{
     }
 
 
-    inline void store(const uint8_t& addr, const VALUE& val){
+    inline void reserve(size_t slots, size_t stack_depth, size_t arrays){
+        memory.assign(slots, VALUE());
+        st.stack.assign(stack_depth, VALUE());
+        st.sp = 0;
+        array_memory.assign(arrays, ARRAY()); // an array itself grows on writes past its end
+    }
+
+    inline void store(const uint16_t& addr, const VALUE& val){
         memory[addr] = val;
     }
 
-    inline void load(const uint8_t& addr){
+    inline void load(const uint16_t& addr){
         st.push(memory[addr]);
     }
 
-    inline void list_at(uint8_t Pos) {
+    inline void list_at(uint16_t Pos) {
         const VALUE& tval = memory[Pos];
 
-        switch (tval.value_type) {
+        switch (tval.type()) {
             case VALUE_TYPE::NUMBER:
                 std::cout << "[memory at " << static_cast<int>(Pos) << "] Type: NUMBER Value: " 
-                        << tval.data.number_value << "\n";
+                        << tval.number() << "\n";
+                break;
+
+            case VALUE_TYPE::INTEGER:
+                std::cout << "[memory at " << static_cast<int>(Pos) << "] Type: INTEGER Value: "
+                        << tval.integer() << "\n";
                 break;
 
             case VALUE_TYPE::NONE:
@@ -157,13 +505,13 @@ struct MEMORY{
 
             case VALUE_TYPE::STRING:
                 std::cout << "[memory at " << static_cast<int>(Pos) << "] Type: STRING Value: " 
-                        << string_hasher->hashed_strings[tval.data.string_pointer_to_string_hash_array]
-                        << " POINTER: " << tval.data.string_pointer_to_string_hash_array << "\n";
+                        << string_hasher->hashed_strings[tval.string_id()]
+                        << " POINTER: " << tval.string_id() << "\n";
                 break;
 
             case VALUE_TYPE::ENUM_OBJECT: {
-                uint8_t type_id = tval.data.enum_data.type_id;
-                uint8_t value_id = tval.data.enum_data.value_id;
+                uint8_t type_id = tval.enum_type();
+                uint8_t value_id = tval.enum_value();
 
                 std::cout << "[memory at " << static_cast<int>(Pos) << "] Type: ENUM_OBJECT "
                         << "(Type " << static_cast<int>(type_id)
@@ -171,40 +519,52 @@ struct MEMORY{
                 break;
             }
             case VALUE_TYPE::ARRAY: {
-                uint8_t array_idx = tval.data.array_pointer;
+                uint32_t array_idx = tval.array_id();
                 std::cout << "[memory at " << static_cast<int>(Pos) << "] Type: ARRAY (Addr " 
-                        << static_cast<int>(array_idx) << ") Elements:\n";
-
-                // Loop through all elements in the array
-                for (int i = 0; i < UINT8_MAX; ++i) {  // You might want actual array size tracking instead of st.sp
-                    const VALUE& elem = array_memory[array_idx][i];
-                    if(elem.value_type==VALUE_TYPE::NONE){
-                        std::cout<<"\n"; // array listing stops at first null elements
-                        return;
+                        << array_idx << ") Elements:\n";
+
+                const ARRAY& array = array_memory[array_idx];
+
+                // Loop through all elements in the array, column-major ones listed by subscripts
+                for (size_t i = 0; i < array.size(); ++i) {
+                    const VALUE elem = array.at(i);
+                    if (array.shape.rank > 1) {
+                        std::cout << "  [";
+                        size_t rest = i;
+                        for (uint8_t d = 0; d < array.shape.rank; d++) {
+                            std::cout << (d ? ", " : "") << rest % array.shape.extents[d];
+                            rest /= array.shape.extents[d];
+                        }
+                        std::cout << "]: ";
+                    } else {
+                        std::cout << "  [" << i << "]: ";
                     }
-                    std::cout << "  [" << i << "]: ";
 
                     // Recursive listing for nested values
-                    switch (elem.value_type) {
+                    switch (elem.type()) {
                         case VALUE_TYPE::NUMBER:
-                            std::cout << "NUMBER: " << elem.data.number_value << "\n";
+                            std::cout << "NUMBER: " << elem.number() << "\n";
+                            break;
+                        case VALUE_TYPE::INTEGER:
+                            std::cout << "INTEGER: " << elem.integer() << "\n";
                             break;
                         case VALUE_TYPE::STRING:
                             std::cout << "STRING: " 
-                                    << string_hasher->hashed_strings[elem.data.string_pointer_to_string_hash_array]
+                                    << string_hasher->hashed_strings[elem.string_id()]
                                     << "\n";
                             break;
                         case VALUE_TYPE::NONE:
                             std::cout << "NONE\n";
                             break;
                         case VALUE_TYPE::ARRAY:
-                            std::cout << "ARRAY (Addr " << static_cast<int>(elem.data.array_pointer) << ")\n";
+                            std::cout << "ARRAY (Addr " << elem.array_id() << ")\n";
                             break;
                         default:
                             std::cout << "UNKNOWN\n";
                             break;
                     }
                 }
+                std::cout << "\n";
                 break;
             }
 
@@ -2,24 +2,127 @@
 #include "../lexer/lexer.h"
 #include "../compiler/compiler.h"
 #include "../parser/ast.h"
+#include "cache/rfc.h"
 #include <iostream>
 #include <fstream>
+#include <cstdlib>
+
+// -------------------- Command line --------------------
+
+struct OPTIONS{
+    std::string source_path = "runtime/main.rf";
+    bool dump_tokens = false;
+    bool dump_ast = false;
+    bool dump_bytecode = false;
+    bool report_time = false;
+};
+
+static void print_usage(){
+    std::cout << "usage: b [options] [script.rf]\n"
+              << "  --dump-tokens     print the token stream\n"
+              << "  --dump-ast        print the syntax tree after constant folding\n"
+              << "  --dump-bytecode   print the generated bytecode\n"
+              << "  --time            print the execution time\n"
+              << "  --help            show this message\n"
+              << "without a script path runtime/main.rf is executed\n";
+}
+
+static OPTIONS parse_options(int argc, char** argv){
+    OPTIONS options;
+    bool has_path = false;
+
+    for(int i = 1; i < argc; i++){
+        const std::string arg = argv[i];
+
+        if(arg == "--dump-tokens"){
+            options.dump_tokens = true;
+        }else if(arg == "--dump-ast"){
+            options.dump_ast = true;
+        }else if(arg == "--dump-bytecode"){
+            options.dump_bytecode = true;
+        }else if(arg == "--time"){
+            options.report_time = true;
+        }else if(arg == "--help" || arg == "-h"){
+            print_usage();
+            std::exit(0);
+        }else if(arg.size() > 1 && arg[0] == '-'){
+            throw_error("Unknown option: " + arg);
+        }else if(has_path){
+            throw_error("Only one script can be run at a time, got: " + arg);
+        }else{
+            options.source_path = arg;
+            has_path = true;
+        }
+    }
+
+    return options;
+}
+
+int main(int argc, char** argv){
+
+    std::ios::sync_with_stdio(false);
+
+    const OPTIONS options = parse_options(argc, argv);
+    const std::string& source_path = options.source_path;
+    const std::string cache_path = RFC_CACHE::path_for(source_path);
+
+    MAPPED_FILE source;
+    if(!source.open(source_path)){
+        throw_error("Could not open source file: " + source_path);
+    }
+    const uint64_t source_hash = hash_source(source.data, source.size);
 
-int main(void){
- 
-    LEXER lexer;
-    lexer.init("runtime/main.rf");
     COMPILER compiler;
-    AST ast;
-    
-    ast.init(lexer.tokens);
+    compiler.report_time = options.report_time;
+
+    // RF_DISPATCH=switch|threaded picks the interpreter loop at run time
+    if(const char* dispatch = std::getenv("RF_DISPATCH")){
+        const std::string mode = dispatch;
+        if(mode == "switch"){
+            compiler.dispatch = DISPATCH_MODE::SWITCH;
+        }else if(mode == "threaded" && RF_THREADED_DISPATCH){
+            compiler.dispatch = DISPATCH_MODE::THREADED;
+        }else{
+            throw_error("Unknown or unsupported RF_DISPATCH mode: " + mode);
+        }
+    }
+
+    std::vector<BTOKEN> bytecode;
+    STRING_HASHER string_hasher;
+    GOTO_HASHER goto_hasher;
+    std::unordered_map<int, std::vector<int>> enum_map;
+
+    // a valid .rfc skips lexing, parsing and codegen, the dumps need the front end so they always compile
+    const bool dumping = options.dump_tokens || options.dump_ast || options.dump_bytecode;
+
+    if(dumping || !RFC_CACHE::load(cache_path, source_hash, bytecode, string_hasher, goto_hasher, enum_map)){
+        LEXER lexer;
+        lexer.init(std::string_view(source.data, source.size)); // tokens point into the mapping, keep it open
+        if(options.dump_tokens){
+            lexer.list();
+        }
+
+        AST ast;
+
+        ast.init(std::move(lexer.tokens));
+        if(options.dump_ast){
+            ast.list();
+        }
+        if(options.dump_bytecode){
+            ast.list_bytecode();
+        }
+
+        bytecode = std::move(ast.bytecode);
+        string_hasher = std::move(ast.string_hasher);
+        goto_hasher = std::move(ast.goto_hasher);
+        enum_map = std::move(ast.enum_map);
+
+        RFC_CACHE::save(cache_path, source_hash, bytecode, string_hasher, enum_map);
+    }
+
+    compiler.memory.init(string_hasher,goto_hasher,enum_map);
 
-    LEXER blexer;
-    blexer.init(ast.bytecode,true);
-    
-    compiler.memory.init(ast.string_hasher,ast.goto_hasher,ast.enum_map); 
+    compiler.init(std::move(bytecode));
 
-    compiler.init(blexer.btokens); 
-    
     return 0;
 }